@@ -0,0 +1,180 @@
+/* Search Benchmark.
+ *
+ * GB/s of the pb search helpers against libc and a plain scalar loop over
+ * a 1 MB buffer. "run" scans with no match, "tok" walks tokens separated
+ * every 12 or 64 bytes, as a protocol parser would.
+ *
+ *   gcc -O2 -I.. pb_find.c ../pb.c ../nm.c -lm -o pb_find && ./pb_find
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "pb.h"
+
+#define SIZE (1024 * 1024)
+#define BYTES (1L << 29)
+
+static const char *all = "\r\n\t ,;:|";
+static char set[9];
+static int setlen;
+
+static double _now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void _fill(char *p, int gap) {
+	int i;
+	for( i = 0; SIZE > i; ++i )
+		p[i] = gap && gap - 1 == i % gap ? '\n' : 'a' + i % 26;
+	pb_set_len(p,SIZE);
+}
+
+static int _scalar_any(const char *s, int len) {
+	int i, k;
+	for( i = 0; len > i; ++i )
+		for( k = 0; setlen > k; ++k )
+			if( s[i] == set[k] )
+				return i;
+	return -1;
+}
+
+static int _scalar_casecmp(const char *s1, const char *s2, int len) {
+	int i, c1, c2;
+	for( i = 0; len > i; ++i ) {
+		c1 = (unsigned char)s1[i];
+		c2 = (unsigned char)s2[i];
+		if( 'A' <= c1 && 'Z' >= c1 )
+			c1 |= 0x20;
+		if( 'A' <= c2 && 'Z' >= c2 )
+			c2 |= 0x20;
+		if( c1 != c2 )
+			return c1 - c2;
+	}
+	return 0;
+}
+
+/* mode 0 pb_find_any, 1 strpbrk, 2 scalar loop */
+static double _any(char *p, int mode) {
+	const char *s = pb_data(p), *r;
+	volatile long acc = 0;
+	long done = 0;
+	double t = _now();
+	int i, n;
+
+	while( BYTES > done ) {
+		for( i = 0; SIZE > i; i += n + 1 ) {
+			if( 0 == mode ) {
+				n = pb_find_any(p,i,set);
+				n = 0 > n ? SIZE - i : n - i;
+			} else if( 1 == mode ) {
+				r = strpbrk(s + i,set);
+				n = r ? r - s - i : SIZE - i;
+			} else {
+				n = _scalar_any(s + i,SIZE - i);
+				n = 0 > n ? SIZE - i : n;
+			}
+			acc += n;
+		}
+		done += SIZE;
+	}
+	return BYTES / 1e9 / (_now() - t);
+}
+
+static void _report_any(char *p, const char *name, int gap, int len) {
+	memcpy(set,all,len);
+	set[len] = '\0';
+	setlen = len;
+	_fill(p,gap);
+	printf("%-8s set %d   pb_find_any %6.2f   strpbrk %6.2f   scalar %6.2f\n",
+		name,setlen,_any(p,0),_any(p,1),_any(p,2));
+}
+
+static void _report_byte(char *p) {
+	const char *s = pb_data(p);
+	volatile long acc = 0;
+	double t, a, b;
+	long i;
+
+	_fill(p,0);
+	t = _now();
+	for( i = 0; BYTES / SIZE > i; ++i )
+		acc += pb_find_byte(p,0,'\n');
+	a = BYTES / 1e9 / (_now() - t);
+	t = _now();
+	for( i = 0; BYTES / SIZE > i; ++i )
+		acc += (long)memchr(s,'\n',SIZE);
+	b = BYTES / 1e9 / (_now() - t);
+	printf("run      byte    pb_find_byte %6.2f   memchr  %6.2f\n",a,b);
+}
+
+static void _report_find(char *p) {
+	const char *s = pb_data(p);
+	volatile long acc = 0;
+	double t, a, b;
+	long i;
+
+	_fill(p,0);
+	t = _now();
+	for( i = 0; BYTES / SIZE > i; ++i )
+		acc += pb_find(p,0,"\r\n\r\n",4);
+	a = BYTES / 1e9 / (_now() - t);
+	t = _now();
+	for( i = 0; BYTES / SIZE > i; ++i )
+		acc += (long)strstr(s,"\r\n\r\n");
+	b = BYTES / 1e9 / (_now() - t);
+	printf("run      substr  pb_find      %6.2f   strstr  %6.2f\n",a,b);
+}
+
+static void _report_casecmp(int len) {
+	char *a = malloc(len), *b = malloc(len), *p;
+	volatile long acc = 0;
+	long i, n = BYTES / len;
+	double t, r[3];
+	int k;
+
+	for( k = 0; len > k; ++k ) {
+		a[k] = 'a' + k % 26;
+		b[k] = 'A' + k % 26;
+	}
+	p = pb_new_len(a,len);
+	t = _now();
+	for( i = 0; n > i; ++i )
+		acc += pb_casecmp(p,b,len);
+	r[0] = BYTES / 1e9 / (_now() - t);
+	t = _now();
+	for( i = 0; n > i; ++i )
+		acc += strncasecmp(a,b,len);
+	r[1] = BYTES / 1e9 / (_now() - t);
+	t = _now();
+	for( i = 0; n > i; ++i )
+		acc += _scalar_casecmp(a,b,len);
+	r[2] = BYTES / 1e9 / (_now() - t);
+	printf("casecmp  %-7d pb_casecmp   %6.2f   strncasecmp %6.2f   scalar %6.2f\n",len,r[0],r[1],r[2]);
+	pb_free(p);
+	free(a);
+	free(b);
+}
+
+int main(void) {
+	char *p = pb_new(SIZE);
+	int len;
+
+	_report_byte(p);
+	_report_find(p);
+	for( len = 2; 8 >= len; len += 2 )
+		_report_any(p,"run",0,len);
+	for( len = 2; 8 >= len; len += 2 )
+		_report_any(p,"tok 64",64,len);
+	for( len = 2; 8 >= len; len += 2 )
+		_report_any(p,"tok 12",12,len);
+	_report_casecmp(16);
+	_report_casecmp(4096);
+	pb_free(p);
+	return 0;
+}
@@ -0,0 +1,104 @@
+/* Rope Benchmark.
+ *
+ * Builds a payload of MB megabytes (default 512) from 16 KB pieces, once
+ * with pb_cat into one buffer and once with pb_rope_cat, then appends one
+ * half-size body to another with pb_cat and with pb_rope_join. Every case
+ * runs in its own process so that the peak RSS is its own.
+ *
+ *   gcc -O2 -I.. pb_rope.c ../pb.c ../nm.c -lm -o pb_rope && ./pb_rope [MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "pb.h"
+
+#define PIECE (16 * 1024)
+
+static char piece[PIECE];
+
+static double _now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void _report(const char *name, long len, double t) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	printf("%-12s %6ld MB %10.2f ms   peak %6ld MB\n",name,len >> 20,t * 1e3,ru.ru_maxrss >> 10);
+	fflush(stdout);
+}
+
+static void _build_pb(long n) {
+	double t = _now();
+	char *p = pb_new(0);
+	long i;
+	for( i = 0; n > i; ++i )
+		p = pb_cat(p,piece,PIECE);
+	_report("pb_cat",pb_len(p),_now() - t);
+	pb_free(p);
+}
+
+static void _build_rope(long n) {
+	double t = _now();
+	pbRope r;
+	long i;
+	pb_rope_init(&r);
+	for( i = 0; n > i; ++i )
+		pb_rope_cat(&r,piece,PIECE);
+	_report("pb_rope_cat",pb_rope_len(&r),_now() - t);
+	pb_rope_free(&r);
+}
+
+static void _join_pb(long n) {
+	char *a = pb_new(0), *b = pb_new(0);
+	double t;
+	long i;
+	for( i = 0; n / 2 > i; ++i ) {
+		a = pb_cat(a,piece,PIECE);
+		b = pb_cat(b,piece,PIECE);
+	}
+	t = _now();
+	a = pb_cat(a,b,pb_len(b));
+	_report("pb_cat join",pb_len(a),_now() - t);
+	pb_free(a);
+	pb_free(b);
+}
+
+static void _join_rope(long n) {
+	pbRope a, b;
+	double t;
+	long i;
+	pb_rope_init(&a);
+	pb_rope_init(&b);
+	for( i = 0; n / 2 > i; ++i ) {
+		pb_rope_cat(&a,piece,PIECE);
+		pb_rope_cat(&b,piece,PIECE);
+	}
+	t = _now();
+	pb_rope_join(&a,&b);
+	_report("pb_rope_join",pb_rope_len(&a),_now() - t);
+	pb_rope_free(&a);
+}
+
+int main(int argc, char **argv) {
+	void (*run[])(long) = { _build_pb, _build_rope, _join_pb, _join_rope };
+	long n = (argc > 1 ? atol(argv[1]) : 512) * 1024 * 1024 / PIECE;
+	unsigned int i;
+
+	memset(piece,'x',sizeof(piece));
+	for( i = 0; sizeof(run) / sizeof(run[0]) > i; ++i ) {
+		if( 0 == fork() ) {
+			run[i](n);
+			_exit(0);
+		}
+		wait(NULL);
+	}
+	return 0;
+}
@@ -13,19 +13,25 @@
 #include <string.h>
 
 #include "ht.h"
+#include "pl.h"
 
 /* -------------------------------- define ----------------------------------- */
 
 #define HT_FREE(_p) \
 	do { if(_p) { free(_p); _p = NULL; } } while(0)
 
+#define HT_POOL_FREE(_h,_p) \
+	do { if(_p) { _ht_free(_h,_p); _p = NULL; } } while(0)
+
 /* -------------------------------- private ---------------------------------- */
 
 static unsigned int ht_hash_function_seed = 5381;
 
 static void _ht_init(htHandle *ht, htType *type);
 static void _ht_reset(htHandle *ht);
-static int _ht_key_index(htHandle *ht, const void *key);
+static void *_ht_calloc(htHandle *ht, unsigned int size);
+static void _ht_free(htHandle *ht, void *p);
+static int _ht_key_index(htHandle *ht, const void *key, unsigned int hash);
 static int _ht_expand_if_needed(htHandle *ht);
 static int _ht_expand(htHandle *ht, unsigned int size);
 static unsigned int _ht_next_power(unsigned int size);
@@ -53,7 +59,8 @@ unsigned int ht_gen_hash_function(const void *key, int len) {
 	const unsigned char *data = (const unsigned char *)key;
 
 	while( 4 <= len ) {
-		unsigned int k = *(unsigned int *)data;
+		unsigned int k;
+		memcpy(&k,data,sizeof(k));
 
 		k *= m;
 		k ^= k >> r;
@@ -94,18 +101,30 @@ static void _ht_reset(htHandle *ht) {
 	ht->used = 0;
 }
 
-static int _ht_key_index(htHandle *ht, const void *key) {
-	unsigned int hash, index;
+static void *_ht_calloc(htHandle *ht, unsigned int size) {
+	if( ht->pool )
+		return pl_calloc(ht->pool,size);
+	return calloc(1,size);
+}
+
+static void _ht_free(htHandle *ht, void *p) {
+	if( ht->pool )
+		pl_free(ht->pool,p);
+	else
+		free(p);
+}
+
+static int _ht_key_index(htHandle *ht, const void *key, unsigned int hash) {
+	unsigned int index;
 	htEntry *he;
 
 	if( !_ht_expand_if_needed(ht) )
 		return HT_INV;
 
-	hash = ht_hash_key(ht,key);
 	index = hash & ht->mask;
 	he = ht->table[index];
 	while( he ) {
-		if( ht_compare_keys(ht,key,he->key) )
+		if( hash == he->hash && ht_compare_keys(ht,key,he->key) )
 			return HT_INV;
 		he = he->next;
 	}
@@ -131,7 +150,8 @@ static int _ht_expand(htHandle *ht, unsigned int size) {
 		return HT_ERR;
 
 	_ht_init(&_ht,ht->type);
-	_ht.table = calloc(1,sizeof(htEntry *) * realsize);
+	_ht.pool = ht->pool;
+	_ht.table = _ht_calloc(ht,sizeof(htEntry *) * realsize);
 	if( !_ht.table )
 		return HT_ERR;
 	_ht.size = realsize;
@@ -166,14 +186,14 @@ static int _ht_clear(htHandle *ht) {
 
 			ht_free_key(ht,he);
 			ht_free_val(ht,he);
-			HT_FREE(he);
+			HT_POOL_FREE(ht,he);
 
 			ht->used--;
 			he = next;
 		}
 		index++;
 	}
-	HT_FREE(ht->table);
+	HT_POOL_FREE(ht,ht->table);
 	_ht_reset(ht);
 	return HT_OK;
 }
@@ -190,7 +210,7 @@ static void _ht_rehash(htHandle *ht, htHandle *_ht) {
 			next = he->next;
 
 			/* rehash */
-			_index = ht_hash_key(_ht,he->key) & _ht->mask;
+			_index = he->hash & _ht->mask;
 			if( !_ht->table[_index] ) {
 				_ht->table[_index] = he;
 				he->prev = he->next = NULL;
@@ -209,7 +229,7 @@ static void _ht_rehash(htHandle *ht, htHandle *_ht) {
 	}
 
 	if( 0 == ht->used ) {
-		HT_FREE(ht->table);
+		HT_POOL_FREE(ht,ht->table);
 		ht[0] = _ht[0];
 	}
 }
@@ -221,16 +241,35 @@ htHandle *ht_create(htType *type) {
 	if( !ht )
 		return NULL;
 	_ht_init(ht,type);
+	ht->pool = NULL;
+	return ht;
+}
+
+htHandle *ht_create_pool(htType *type, void *pool) {
+	htHandle *ht = pl_alloc(pool,sizeof(*ht));
+	if( !ht )
+		return NULL;
+	_ht_init(ht,type);
+	ht->pool = pool;
 	return ht;
 }
 
 void ht_destroy(htHandle *ht) {
 	_ht_clear(ht);
-	HT_FREE(ht);
+	if( ht->pool )
+		pl_free(ht->pool,ht);
+	else
+		HT_FREE(ht);
 }
 
 int ht_add(htHandle *ht, void *key, void *val) {
-	htEntry *he = ht_add_raw(ht,key);
+	return ht_add_hash(ht,key,ht_hash_key(ht,key),val);
+}
+
+/* Adds key with a hash the caller already has, e.g. from an entry of a
+ * table of the same type. */
+int ht_add_hash(htHandle *ht, void *key, unsigned int hash, void *val) {
+	htEntry *he = ht_add_raw_hash(ht,key,hash);
 	if( !he )
 		return HT_ERR;
 	ht_set_val(ht,he,val);
@@ -238,15 +277,20 @@ int ht_add(htHandle *ht, void *key, void *val) {
 }
 
 htEntry *ht_add_raw(htHandle *ht, void *key) {
+	return ht_add_raw_hash(ht,key,ht_hash_key(ht,key));
+}
+
+htEntry *ht_add_raw_hash(htHandle *ht, void *key, unsigned int hash) {
 	int index;
 	htEntry *he;
 
-	if( HT_INV == (index = _ht_key_index(ht,key)) )
+	if( HT_INV == (index = _ht_key_index(ht,key,hash)) )
 		return NULL;
 
-	he = calloc(1,sizeof(*he));
+	he = _ht_calloc(ht,sizeof(*he));
 	if( !he )
 		return NULL;
+	he->hash = hash;
 	if( !ht->table[index] ) {
 		ht->table[index] = he;
 		he->prev = he->next = NULL;
@@ -268,13 +312,12 @@ htEntry *ht_put_raw(htHandle *ht, void *key) {
 }
 
 void ht_delete(htHandle *ht, htEntry *he) {
-	unsigned int hash, index;
+	unsigned int index;
 
 	if( 0 == ht->size )
 		return;
 
-	hash = ht_hash_key(ht,he->key);
-	index = hash & ht->mask;
+	index = he->hash & ht->mask;
 
 	if( he->prev )
 		he->prev->next = he->next;
@@ -285,7 +328,7 @@ void ht_delete(htHandle *ht, htEntry *he) {
 
 	ht_free_key(ht,he);
 	ht_free_val(ht,he);
-	HT_FREE(he);
+	HT_POOL_FREE(ht,he);
 	ht->used--;
 }
 
@@ -294,17 +337,23 @@ void ht_clear(htHandle *ht) {
 }
 
 htEntry *ht_find(htHandle *ht, const void *key) {
-	unsigned int hash, index;
+	if( 0 == ht->size )
+		return NULL;
+	return ht_find_hash(ht,key,ht_hash_key(ht,key));
+}
+
+/* Looks key up by a hash the caller computed with the table's own hash
+ * function, e.g. once for many tables. Entries keep their hash, so only
+ * keys with an equal hash are compared. */
+htEntry *ht_find_hash(htHandle *ht, const void *key, unsigned int hash) {
 	htEntry *he;
 
 	if( 0 == ht->size )
 		return NULL;
 
-	hash = ht_hash_key(ht,key);
-	index = hash & ht->mask;
-	he = ht->table[index];
+	he = ht->table[hash & ht->mask];
 	while( he ) {
-		if( ht_compare_keys(ht,key,he->key) )
+		if( hash == he->hash && ht_compare_keys(ht,key,he->key) )
 			return he;
 		he = he->next;
 	}
@@ -348,13 +397,18 @@ htIterator *ht_create_iterator(htHandle *ht) {
 	htIterator *iter = malloc(sizeof(*iter));
 	if( !iter )
 		return NULL;
+	ht_init_iterator(ht,iter);
+	return iter;
+}
+
+/* Sets up an iterator the caller owns, e.g. on the stack. */
+void ht_init_iterator(htHandle *ht, htIterator *iter) {
 	iter->ht = ht;
 	if( 0 < ht->size )
 		iter->next = ht->table[0];
 	else
 		iter->next = NULL;
 	iter->index = 0;
-	return iter;
 }
 
 void ht_destroy_iterator(htIterator *iter) {
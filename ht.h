@@ -32,6 +32,7 @@ typedef struct htEntry {
 		long s64;
 		double d64;
 	} v;
+	unsigned int hash;
 	struct htEntry *prev;
 	struct htEntry *next;
 } htEntry;
@@ -42,6 +43,7 @@ typedef struct htHandle {
 	unsigned int size;
 	unsigned int mask;
 	unsigned int used;
+	void *pool;
 } htHandle;
 
 typedef struct htIterator {
@@ -111,16 +113,21 @@ unsigned int ht_gen_hash_function(const void *key, int len);
 /* -------------------------------- api functions ---------------------------- */
 
 htHandle *ht_create(htType *type);
+htHandle *ht_create_pool(htType *type, void *pool);
 void ht_destroy(htHandle *ht);
 int ht_add(htHandle *ht, void *key, void *val);
+int ht_add_hash(htHandle *ht, void *key, unsigned int hash, void *val);
 htEntry *ht_add_raw(htHandle *ht, void *key);
+htEntry *ht_add_raw_hash(htHandle *ht, void *key, unsigned int hash);
 htEntry *ht_put_raw(htHandle *ht, void *key);
 void ht_delete(htHandle *ht, htEntry *he);
 void ht_clear(htHandle *ht);
 htEntry *ht_find(htHandle *ht, const void *key);
+htEntry *ht_find_hash(htHandle *ht, const void *key, unsigned int hash);
 htEntry *ht_random(htHandle *ht);
 int ht_resize(htHandle *ht);
 htIterator *ht_create_iterator(htHandle *ht);
+void ht_init_iterator(htHandle *ht, htIterator *iter);
 void ht_destroy_iterator(htIterator *iter);
 htEntry *ht_next(htIterator *iter);
 void ht_status(htHandle *ht);
@@ -4,42 +4,242 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
 #include <float.h>
 #include <limits.h>
 #include <math.h>
-#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define JS_AVX2
+#endif
 
 #include "ht.h"
-#include "ls.h"
+#include "nm.h"
+#include "pl.h"
 
 #include "js.h"
 
 /* -------------------------------- struct ----------------------------------- */
 
+/* Print target. Output grows a js buffer, or goes out through flush each
+ * time the size bytes of buf fill up. */
+typedef struct jsWriter {
+	char *buf;
+	int len;
+	int size;
+	int (*flush)(void *ud, const char *buf, int len);
+	void *ud;
+} jsWriter;
+
+/* A value in 16 bytes. Strings of up to JS_INLINE_MAX bytes are kept in
+ * v itself, NUL-terminated; len is the length of a string or array. */
 typedef struct jsObject {
-	int type;
-	int idouble;
 	union {
 		void *val;
 		long l64;
 		double d64;
+		char str[8];
 	} v;
-	char *name;
-	int (*print)(struct jsObject *obj, char **buf);
+	int len;
+	unsigned char type;
+	unsigned char flags;
 } jsObject;
 
+/* Array elements, stored contiguously. */
+typedef struct jsArray {
+	int len;
+	int size;
+	jsObject *item[];
+} jsArray;
+
 typedef struct jsBuffer {
 	int len;
 	int free;
 	char buf[];
 } jsBuffer;
 
+/* Parse state. The parser only emits events to sax; escaped strings are
+ * decoded into tmp, or inside the input when parsing in situ. */
+typedef struct jsParser {
+	plHandle *pool;
+	jsDict *dict;
+	const char *err;
+	int insitu;
+	jsSax *sax;
+	void *ud;
+	char *tmp;
+} jsParser;
+
+/* DOM builder driven by the parser events. With a pool every node, table,
+ * array and string of the document is carved from it and nothing is freed
+ * one by one. In situ, keys and strings point into the input. The key
+ * read last waits in key for its value. The elements of open arrays wait
+ * in vals and are moved into an array of their exact size when it
+ * closes. */
+typedef struct jsBuilder {
+	jsParser *ps;
+	jsObject *root;
+	jsObject **stack;
+	int depth;
+	int size;
+	jsObject **vals;
+	int nval;
+	int vsize;
+	char *key;
+	jsObject *inl[32];
+} jsBuilder;
+
+/* Parser state machine, fed either bytes by js_feed or the structural
+ * index of a whole document. The containers still open are kept on stack
+ * as 'O' or 'A'; a string, number or literal cut by the end of a chunk is
+ * carried over in tok. */
+typedef struct jsFeed {
+	jsParser ps;
+	jsBuilder b;
+	char *stack;
+	int depth;
+	int size;
+	char *tok;
+	int state;
+	int key;
+	int esc;
+	int bslash;
+} jsFeed;
+
+/* Structural index of a document, built by stage one a few blocks ahead
+ * of stage two into a fixed window, so parsing needs no index allocation
+ * whatever the size of the input. The carries link consecutive blocks. */
+typedef struct jsIndex {
+	const char *buf;
+	unsigned int len;
+	unsigned int base;
+	uint64_t esc;
+	uint64_t in;
+	uint64_t term;
+	int n;
+	int i;
+	unsigned int idx[1024];
+} jsIndex;
+
+/* Character classes of a 64 byte block, one bit per byte. */
+typedef struct jsBlock {
+	uint64_t quote;
+	uint64_t bslash;
+	uint64_t op;
+	uint64_t ws;
+} jsBlock;
+
+/* One step of a compiled path. key is unescaped and hashed with the table
+ * hash; index is the array index the step reads as, or -1. */
+typedef struct jsStep {
+	char *key;
+	unsigned int hash;
+	int index;
+} jsStep;
+
+/* An interned key. Tables of a dict keep str and read hash back from it. */
+typedef struct jsKey {
+	unsigned int hash;
+	int len;
+	char str[];
+} jsKey;
+
+/* Keys shared by documents, carved from pool and found again by open
+ * addressing. The tables of its documents use the dict's own types, so
+ * their members only move between documents of the same dict. */
+struct jsDict {
+	plHandle *pool;
+	jsKey **slot;
+	unsigned int size;
+	unsigned int used;
+	htType type;
+	htType pool_type;
+};
+
+/* A run of whole records, parsed by a worker into docs carved from pool.
+ * The pool is reset once the docs have been handed out. */
+typedef struct jsChunk {
+	const char *buf;
+	long len;
+	int state;
+	plHandle *pool;
+	jsHandle *docs;
+	int n;
+	int size;
+} jsChunk;
+
+/* Newline-delimited input shared by the workers. Chunk number i is cut
+ * at off when a worker takes it and lives in chunk[i % nchunk] until the
+ * caller thread has delivered it. */
+typedef struct jsLines {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	const char *buf;
+	long len;
+	long off;
+	int next;
+	int stop;
+	jsChunk *chunk;
+	int nchunk;
+} jsLines;
+
+/* A compiled path, its keys stored after the steps. */
+struct jsPath {
+	int n;
+	jsStep step[];
+};
+
 /* -------------------------------- private ---------------------------------- */
 
 #define JS_BUFFER_SIZE_INIT 4
+#define JS_PRINT_SIZE_INIT 256
+#define JS_PRINT_CHUNK 16384
+
+#define JS_INLINE_MAX 7
+
+#define JS_FLAG_DOUBLE 0x01
+#define JS_FLAG_VIEW 0x02
+#define JS_FLAG_INLINE 0x04
+
+#define JS_DICT_SIZE_INIT 64
+
+#define JS_LINES_CHUNK (1 << 20)
+#define JS_LINES_THREADS_MAX 64
+
+#define JS_CHUNK_FREE 0
+#define JS_CHUNK_BUSY 1
+#define JS_CHUNK_DONE 2
+#define JS_CHUNK_ERROR 3
+
+#define JS_FEED_VALUE 0
+#define JS_FEED_ARRAY_FIRST 1
+#define JS_FEED_ARRAY_NEXT 2
+#define JS_FEED_OBJECT_FIRST 3
+#define JS_FEED_OBJECT_KEY 4
+#define JS_FEED_OBJECT_COLON 5
+#define JS_FEED_OBJECT_NEXT 6
+#define JS_FEED_STRING 7
+#define JS_FEED_NUMBER 8
+#define JS_FEED_LITERAL 9
+#define JS_FEED_DONE 10
+#define JS_FEED_ERROR 11
+
+#define JS_SAX_CALL(_s,_f,...) \
+	((_s)->sax->_f ? (_s)->sax->_f((_s)->ud,##__VA_ARGS__) : JS_OK)
 
 #define JS_OBJECT_FREE(_p) \
 	do { if(_p) { _js_object_free(_p); _p = NULL; } } while(0)
@@ -47,14 +247,25 @@ typedef struct jsBuffer {
 	do { if(_p) { _js_buffer_free(_p); _p = NULL; } } while(0)
 #define JS_TABLE_FREE(_p) \
 	do { if(_p) { ht_destroy(_p); _p = NULL; } } while(0)
-#define JS_LIST_FREE(_p) \
-	do { if(_p) { ls_destroy(_p); _p = NULL; } } while(0)
+#define JS_ARRAY_FREE(_p) \
+	do { if(_p) { _js_array_free(_p); _p = NULL; } } while(0)
 #define JS_FREE(_p) \
 	do { if(_p) { free(_p); _p = NULL; } } while(0)
+#define JS_PARSER_FREE(_s,_p) \
+	do { if(_p && !(_s)->pool) { _js_object_free(_p); } _p = NULL; } while(0)
+
+#define JS_OBJECT_STR(_o) \
+	((_o)->flags & JS_FLAG_INLINE ? (_o)->v.str : (char *)(_o)->v.val)
+
+#define JS_KEY(_k) \
+	((jsKey *)((char *)(_k) - offsetof(jsKey,str)))
 
 #define JS_MAX(_a, _b) \
 	(_a) > (_b) ? (_a) : (_b)
 
+#define JS_WRITER_ROOM(_w,_n) \
+	((_w)->size - (_w)->len >= (_n) || _js_writer_grow(_w,_n))
+
 /* -------------------------------- private ---------------------------------- */
 
 // hash functions
@@ -62,6 +273,8 @@ static unsigned int _js_hash_function(const void *key);
 static int _js_hash_key_compare(const void *key1, const void *key2);
 static void _js_hash_key_free(void *key);
 static void _js_hash_val_free(void *val);
+static unsigned int _js_dict_hash_function(const void *key);
+static int _js_dict_key_compare(const void *key1, const void *key2);
 
 static htType htTypeJson = {
 	_js_hash_function,
@@ -72,63 +285,196 @@ static htType htTypeJson = {
 	_js_hash_val_free
 };
 
-// list functions
-static void _js_list_free(void *ptr);
+static htType htTypeJsonView = {
+	_js_hash_function,
+	NULL,
+	NULL,
+	_js_hash_key_compare,
+	NULL,
+	_js_hash_val_free
+};
+
+static htType htTypeJsonPool = {
+	_js_hash_function,
+	NULL,
+	NULL,
+	_js_hash_key_compare,
+	NULL,
+	NULL
+};
+
+static htType htTypeJsonDict = {
+	_js_dict_hash_function,
+	NULL,
+	NULL,
+	_js_dict_key_compare,
+	NULL,
+	_js_hash_val_free
+};
 
-static lsType lsTypeJson = {
-	_js_list_free
+static htType htTypeJsonDictPool = {
+	_js_dict_hash_function,
+	NULL,
+	NULL,
+	_js_dict_key_compare,
+	NULL,
+	NULL
 };
 
+// json array
+static jsArray *_js_array_new(plHandle *pool, jsObject **item, int len);
+static void _js_array_free(jsArray *a);
+
 // json buffer
 static char *_js_buffer_new(int size);
-static char *_js_buffer_newlen(int size);
+static char *_js_buffer_newlen(plHandle *pool, int size);
 static char *_js_buffer_renew(char *p, int size);
 static void _js_buffer_free(char *p);
 static int _js_buffer_len(char *p);
 static char *_js_buffer_cat(char *p, const char *buf, int len);
-static char *_js_buffer_vsprintf(char *p, const char *fmt, va_list va);
-static int _js_buffer_sprintf(char **p, const char *fmt, ...);
+static void _js_buffer_clear(char *p);
 
 // json object
-static jsObject *_js_object_new();
+static jsObject *_js_object_new(plHandle *pool, int view);
 static void _js_object_free(jsObject *obj);
 
-static int _js_object_add_object(jsObject *obj, jsObject *sub);
+static int _js_object_add_object(jsObject *obj, char *key, jsObject *sub);
 
-static void _js_object_set_type(jsObject *obj, int type);
 static void _js_object_set_object(jsObject *obj, void *value);
 static void _js_object_set_array(jsObject *obj, void *value);
-static void _js_object_set_string(jsObject *obj, char *value);
-static void _js_object_set_number(jsObject *obj, double value, int idouble);
+static void _js_object_set_string(jsObject *obj, char *value, int len);
+static void _js_object_set_inline(jsObject *obj, const char *value, int len);
+static void _js_object_set_integer(jsObject *obj, long value);
+static void _js_object_set_number(jsObject *obj, double value);
 static void _js_object_set_bool(jsObject *obj, int value);
 static void _js_object_set_null(jsObject *obj);
 
-static int _js_object_string_escape(char **in);
-static int _js_object_object_print(jsObject *obj, char **buf);
-static int _js_object_array_print(jsObject *obj, char **buf);
-static int _js_object_string_print(jsObject *obj, char **buf);
-static int _js_object_number_print(jsObject *obj, char **buf);
-static int _js_object_boolean_print(jsObject *obj, char **buf);
-static int _js_object_null_print(jsObject *obj, char **buf);
+static int _js_object_print(jsObject *obj, jsWriter *w);
+static int _js_object_object_print(jsObject *obj, jsWriter *w);
+static int _js_object_array_print(jsObject *obj, jsWriter *w);
+static int _js_object_string_print(jsObject *obj, jsWriter *w);
+static int _js_object_number_print(jsObject *obj, jsWriter *w);
+static int _js_object_boolean_print(jsObject *obj, jsWriter *w);
+static int _js_object_null_print(jsObject *obj, jsWriter *w);
+
+// json writer
+static int _js_writer_flush(jsWriter *w);
+static int _js_writer_grow(jsWriter *w, int n);
+static int _js_writer_put(jsWriter *w, const char *str, int len);
+static int _js_writer_char(jsWriter *w, char c);
+static int _js_writer_span(const char *str, int len);
+static int _js_writer_escape(jsWriter *w, const char *str, int len);
+static int _js_writer_fd(void *ud, const char *buf, int len);
 
 // json parse
-static const char *_js_skip(const char *in);
-static const char *_js_string_escape(const char *in, int *pos);
-static const char *_js_parse_value(jsObject *obj, const char *value, const char **pos);
-static const char *_js_parse_name(jsObject *obj, const char *value, const char **pos);
-static const char *_js_parse_string(jsObject *obj, const char *value);
-static const char *_js_parse_number(jsObject *obj, const char *value);
-static const char *_js_parse_array(jsObject *obj, const char *value, const char **pos);
-static const char *_js_parse_object(jsObject *obj, const char *value, const char **pos);
+static int _js_hex4(const char *in);
+static int _js_string_decode(char *out, const char *in, int len);
+static const char *_js_parse_number(jsParser *ps, const char *value);
+
+// json index
+static void _js_classify(const char *p, jsBlock *m);
+#if defined(__SSE2__)
+static void _js_classify_sse2(const char *p, jsBlock *m);
+#endif
+#if defined(JS_AVX2)
+static void _js_classify_avx2(const char *p, jsBlock *m);
+#endif
+static uint64_t _js_odd_escapes(uint64_t bs, uint64_t *carry);
+static uint64_t _js_prefix_xor(uint64_t x);
+static void _js_index_init(jsIndex *ix, const char *buf, int len);
+static int _js_index_fill(jsIndex *ix);
+static char *_js_index_next(jsIndex *ix);
+
+// json builder
+static void _js_build_init(jsBuilder *b, jsParser *ps);
+static void _js_build_release(jsBuilder *b);
+static int _js_build_push(jsBuilder *b, jsObject *obj);
+static int _js_build_push_val(jsBuilder *b, jsObject *obj);
+static int _js_build_add(jsBuilder *b, jsObject *obj);
+static jsObject *_js_build_new(jsBuilder *b);
+static char *_js_build_str(jsBuilder *b, const char *str, int len);
+static int _js_build_container(jsBuilder *b, int type);
+static int _js_build_start_object(void *ud);
+static int _js_build_start_array(void *ud);
+static int _js_build_end(void *ud);
+static int _js_build_end_array(void *ud);
+static int _js_build_key(void *ud, const char *str, int len);
+static int _js_build_string(void *ud, const char *str, int len);
+static int _js_build_integer(void *ud, long value);
+static int _js_build_number(void *ud, double value);
+static int _js_build_boolean(void *ud, int value);
+static int _js_build_null(void *ud);
+
+static jsSax jsSaxBuild = {
+	_js_build_start_object,
+	_js_build_end,
+	_js_build_start_array,
+	_js_build_end_array,
+	_js_build_key,
+	_js_build_string,
+	_js_build_integer,
+	_js_build_number,
+	_js_build_boolean,
+	_js_build_null
+};
+
+// json feed
+static void _js_feed_init(jsFeed *f, jsHandle *js, jsSax *sax, void *ud);
+static void _js_feed_release(jsFeed *f);
+static jsFeed *_js_feed_new(jsHandle *js);
+static void _js_feed_free(jsHandle *js);
+static int _js_feed_open(jsFeed *f, int type);
+static void _js_feed_close(jsFeed *f);
+static int _js_feed_emit(jsFeed *f, char *str, int n, int esc, int inplace);
+static int _js_feed_scalar(jsFeed *f, const char *p);
+static int _js_feed_index(jsFeed *f, char *buf, int len);
+static int _js_feed_string(jsFeed *f, const char *p, const char *end, const char **next);
+static int _js_feed_token(jsFeed *f, const char *p, const char *end, const char **next);
+static int _js_feed_token_end(jsFeed *f);
+static int _js_feed(jsHandle *js, const char *chunk, int len);
+static int _js_finish(jsHandle *js);
+
+// json path
+static int _js_path_index(const char *str, int len);
+static void _js_path_key(jsStep *step, int len);
+static jsPath *_js_path_new(int len);
+static jsPath *_js_pointer_compile(const char *str);
+static jsPath *_js_path_compile(const char *str);
+static jsObject *_js_path_get(jsPath *path, jsObject *obj);
+
+// json merge
+static int _js_equal(jsObject *a, jsObject *b);
+static int _js_merge_domain(jsObject *obj, jsObject *patch);
+static int _js_merge_move(htHandle *ht, htEntry *he, htHandle *pht, htEntry *phe);
+static void _js_merge_strip(jsObject *obj);
+static int _js_merge_object(jsObject *obj, jsObject *patch, int *changed);
+
+// json dict
+static jsDict *_js_dict_new(void);
+static void _js_dict_free(jsDict *dict);
+static int _js_dict_expand(jsDict *dict);
+static char *_js_dict_intern(jsDict *dict, const char *str, int len);
+
+// json lines
+static int _js_lines_blank(const char *p, long n);
+static int _js_lines_chunk(jsLines *l, jsChunk *c);
+static void *_js_lines_worker(void *arg);
+static int _js_lines_deliver(jsChunk *c, int (*cb)(void *ud, jsHandle *js), void *ud);
+static int _js_lines(const char *buf, long len, int threads, int (*cb)(void *ud, jsHandle *js), void *ud);
+static int _js_lines_file(const char *path, int threads, int (*cb)(void *ud, jsHandle *js), void *ud);
 
 // json functions
 static void _js_init(jsHandle *js);
 static void _js_reset(jsHandle *js);
 static void _js_free(jsHandle *js);
 
-static int _js_parse(jsHandle *js, const char *str);
+static int _js_parse(jsHandle *js, const char *str, int len, int insitu);
+static int _js_sax_parse(jsHandle *js, const char *str, int len, jsSax *sax, void *ud);
 static int _js_replace(jsObject *obj, jsObject *rep);
+static int _js_merge(jsObject *obj, jsObject *patch, int *changed);
+static int _js_foreach(jsObject *obj, int (*cb)(void *ud, const char *key, void *val), void *ud);
 static char *_js_print(jsObject *obj, int *len);
+static int _js_print_cb(jsObject *obj, int (*flush)(void *ud, const char *buf, int len), void *ud);
 
 /* -------------------------------- private implementation ------------------- */
 
@@ -138,11 +484,7 @@ static unsigned int _js_hash_function(const void *key) {
 }
 
 static int _js_hash_key_compare(const void *key1, const void *key2) {
-	int len1 = _js_buffer_len((char *)key1);
-	int len2 = _js_buffer_len((char *)key2);
-	if( len1 != len2 )
-		return HT_ERR;
-	return 0 == memcmp((const char *)key1,(const char *)key2,len1);
+	return 0 == strcmp((const char *)key1,(const char *)key2);
 }
 
 static void _js_hash_key_free(void *key) {
@@ -153,9 +495,36 @@ static void _js_hash_val_free(void *val) {
 	JS_OBJECT_FREE(val);
 }
 
-// list functions
-static void _js_list_free(void *ptr) {
-	JS_OBJECT_FREE(ptr);
+static unsigned int _js_dict_hash_function(const void *key) {
+	return JS_KEY(key)->hash;
+}
+
+/* Keys of one dict are equal only when they are the same pointer; keys
+ * from elsewhere, as in lookups, only get here with an equal hash. */
+static int _js_dict_key_compare(const void *key1, const void *key2) {
+	return key1 == key2 || 0 == strcmp((const char *)key1,(const char *)key2);
+}
+
+// json array
+static jsArray *_js_array_new(plHandle *pool, jsObject **item, int len) {
+	jsArray *a;
+	if( pool )
+		a = pl_alloc(pool,sizeof(*a) + len * sizeof(a->item[0]));
+	else
+		a = malloc(sizeof(*a) + len * sizeof(a->item[0]));
+	if( !a )
+		return NULL;
+	a->len = a->size = len;
+	if( len )
+		memcpy(a->item,item,len * sizeof(a->item[0]));
+	return a;
+}
+
+static void _js_array_free(jsArray *a) {
+	int i;
+	for( i = 0; a->len > i; ++i )
+		JS_OBJECT_FREE(a->item[i]);
+	JS_FREE(a);
 }
 
 // json buffer
@@ -168,8 +537,12 @@ static char *_js_buffer_new(int size) {
 	return jbuf->buf;
 }
 
-static char *_js_buffer_newlen(int size) {
-	jsBuffer *jbuf = calloc(1,sizeof(*jbuf) + size + 1);
+static char *_js_buffer_newlen(plHandle *pool, int size) {
+	jsBuffer *jbuf;
+	if( pool )
+		jbuf = pl_alloc(pool,sizeof(*jbuf) + size + 1);
+	else
+		jbuf = calloc(1,sizeof(*jbuf) + size + 1);
 	if( !jbuf )
 		return NULL;
 	jbuf->free = 0;
@@ -213,35 +586,24 @@ static char *_js_buffer_cat(char *p, const char *buf, int len) {
 	return p;
 }
 
-static char *_js_buffer_vsprintf(char *p, const char *fmt, va_list va) {
-	char *buf;
-	char *t;
-	int len;
-	if( JS_INV == (len = vasprintf(&buf,fmt,va)) )
-		return NULL;
-	t = _js_buffer_cat(p,buf,len);
-	JS_FREE(buf);
-	return t;
-}
-
-static int _js_buffer_sprintf(char **p, const char *fmt, ...) {
-	char *t;
-	va_list va;
-	va_start(va,fmt);
-	if( !(t = _js_buffer_vsprintf(p[0],fmt,va)) ) {
-		va_end(va);
-		return JS_ERR;
-	}
-	va_end(va);
-	p[0] = t;
-	return JS_OK;
+static void _js_buffer_clear(char *p) {
+	jsBuffer *jbuf = (jsBuffer *)(p - sizeof(*jbuf));
+	jbuf->free += jbuf->len;
+	jbuf->len = 0;
+	p[0] = '\0';
 }
 
 // json object
-static jsObject *_js_object_new() {
-	jsObject *obj = calloc(1,sizeof(*obj));
+static jsObject *_js_object_new(plHandle *pool, int view) {
+	jsObject *obj;
+	if( pool )
+		obj = pl_calloc(pool,sizeof(*obj));
+	else
+		obj = calloc(1,sizeof(*obj));
 	if( !obj )
 		return NULL;
+	if( view )
+		obj->flags = JS_FLAG_VIEW;
 	return obj;
 }
 
@@ -249,549 +611,1692 @@ static void _js_object_free(jsObject *obj) {
 	switch( obj->type ) {
 	case JS_OBJECT:
 		JS_TABLE_FREE(obj->v.val);
-		JS_BUFER_FREE(obj->name);
 		break;
 	case JS_ARRAY:
-		JS_LIST_FREE(obj->v.val);
+		JS_ARRAY_FREE(obj->v.val);
 		break;
 	case JS_STRING:
-		JS_BUFER_FREE(obj->v.val);
+		if( !(obj->flags & (JS_FLAG_VIEW | JS_FLAG_INLINE)) )
+			JS_BUFER_FREE(obj->v.val);
 	}
 	JS_FREE(obj);
 }
 
-static int _js_object_add_object(jsObject *obj, jsObject *sub) {
-	switch( obj->type ) {
-	case JS_OBJECT:
-		if( !ht_add(obj->v.val,obj->name,sub) )
-			return JS_ERR;
-		obj->name = NULL;
-		break;
-	case JS_ARRAY:
-		if( !ls_add_tail(obj->v.val,sub) )
-			return JS_ERR;
-	}
+static int _js_object_add_object(jsObject *obj, char *key, jsObject *sub) {
+	if( JS_OBJECT != obj->type || !ht_add(obj->v.val,key,sub) )
+		return JS_ERR;
 	return JS_OK;
 }
 
-static void _js_object_set_type(jsObject *obj, int type) {
-	switch( type ) {
-	case JS_OBJECT:
-		obj->print = _js_object_object_print;
-		break;
-	case JS_ARRAY:
-		obj->print = _js_object_array_print;
-		break;
-	case JS_STRING:
-		obj->print = _js_object_string_print;
-		break;
-	case JS_NUMBER:
-		obj->print = _js_object_number_print;
-		break;
-	case JS_BOOLEAN:
-		obj->print = _js_object_boolean_print;
-		break;
-	case JS_NULL:
-		obj->print = _js_object_null_print;
-	}
-	obj->type = type;
-}
-
 static void _js_object_set_object(jsObject *obj, void *value) {
-	_js_object_set_type(obj,JS_OBJECT);
+	obj->type = JS_OBJECT;
 	obj->v.val = value;
 }
 
 static void _js_object_set_array(jsObject *obj, void *value) {
-	_js_object_set_type(obj,JS_ARRAY);
+	obj->type = JS_ARRAY;
 	obj->v.val = value;
 }
 
-static void _js_object_set_string(jsObject *obj, char *value) {
-	_js_object_set_type(obj,JS_STRING);
+static void _js_object_set_string(jsObject *obj, char *value, int len) {
+	obj->type = JS_STRING;
 	obj->v.val = value;
+	obj->len = len;
 }
 
-static void _js_object_set_number(jsObject *obj, double value, int idouble) {
-	_js_object_set_type(obj,JS_NUMBER);
-	if( idouble )
-		obj->v.d64 = value;
-	else
-		obj->v.l64 = (long)value;
-	obj->idouble = idouble;
+static void _js_object_set_inline(jsObject *obj, const char *value, int len) {
+	obj->type = JS_STRING;
+	obj->flags |= JS_FLAG_INLINE;
+	memcpy(obj->v.str,value,len);
+	obj->v.str[len] = '\0';
+	obj->len = len;
+}
+
+static void _js_object_set_integer(jsObject *obj, long value) {
+	obj->type = JS_NUMBER;
+	obj->flags &= ~JS_FLAG_DOUBLE;
+	obj->v.l64 = value;
+}
+
+static void _js_object_set_number(jsObject *obj, double value) {
+	obj->type = JS_NUMBER;
+	obj->flags |= JS_FLAG_DOUBLE;
+	obj->v.d64 = value;
 }
 
 static void _js_object_set_bool(jsObject *obj, int value) {
-	_js_object_set_type(obj,JS_BOOLEAN);
+	obj->type = JS_BOOLEAN;
 	obj->v.l64 = (long)value;
 }
 
 static void _js_object_set_null(jsObject *obj) {
-	_js_object_set_type(obj,JS_NULL);
+	obj->type = JS_NULL;
 }
 
-static int _js_object_string_escape(char **in) {
-	const char *val = in[0];
-	char *str, *out;
-	char c;
-	int len = 0;
-
-	while( (c = (val++)[0]) && ++len )
-		if( strchr("\"\\\b\f\n\r\t",c) )
-			len++;
-
-	str = _js_buffer_newlen(len);
-	if( !str )
-		return JS_ERR;
-
-	val = in[0];
-	out = str;
-
-	while( val[0] ) {
-		if( 31 < (unsigned char)val[0] && '\"' != val[0] && '\\' != val[0] )
-			(out++)[0] = (val++)[0];
-		else {
-			(out++)[0] = '\\';
-			switch( (c = (val++)[0]) ) {
-			case '\"':
-				(out++)[0] = '\"';
-				break;
-			case '\\':
-				(out++)[0] = '\\';
-				break;
-			case '\b':
-				(out++)[0] = 'b';
-				break;
-			case '\f':
-				(out++)[0] = 'f';
-				break;
-			case '\n':
-				(out++)[0] = 'n';
-				break;
-			case '\r':
-				(out++)[0] = 'r';
-				break;
-			case '\t':
-				(out++)[0] = 't';
-				break;
-			default:
-				(--out)[0] = '?';
-				out++;
-			}
-		}
+static int _js_object_print(jsObject *obj, jsWriter *w) {
+	switch( obj->type ) {
+	case JS_OBJECT:
+		return _js_object_object_print(obj,w);
+	case JS_ARRAY:
+		return _js_object_array_print(obj,w);
+	case JS_STRING:
+		return _js_object_string_print(obj,w);
+	case JS_NUMBER:
+		return _js_object_number_print(obj,w);
+	case JS_BOOLEAN:
+		return _js_object_boolean_print(obj,w);
 	}
-	out[0] = '\0';
-
-	JS_BUFER_FREE(in[0]);
-	in[0] = str;
-	return JS_OK;
+	return _js_object_null_print(obj,w);
 }
 
-static int _js_object_object_print(jsObject *obj, char **buf) {
-	int n = 0;
+static int _js_object_object_print(jsObject *obj, jsWriter *w) {
+	htIterator hi;
 	htEntry *he;
-	htIterator *hi;
-
-	if( !buf || !buf[0] || !obj )
-	return JS_ERR;
+	jsObject *sub;
+	const char *key;
+	int n = 0;
 
-	if( !_js_buffer_sprintf(buf,"{") )
+	if( !_js_writer_char(w,'{') )
 		return JS_ERR;
-	hi = ht_create_iterator(obj->v.val);
-	if( !hi )
-		return JS_ERR;
-	while( (he = ht_next(hi)) ) {
-		if( n++ )
-			if( !_js_buffer_sprintf(buf,",") )
-				return JS_ERR;
-
-		if( !_js_buffer_sprintf(buf,"\"") )
+	ht_init_iterator(obj->v.val,&hi);
+	while( (he = ht_next(&hi)) ) {
+		if( !JS_WRITER_ROOM(w,2) )
 			return JS_ERR;
-		if( !_js_object_string_escape((char **)&ht_get_key(he)) )
-			return JS_ERR;
-		if( !_js_buffer_sprintf(buf,ht_get_key(he)) )
+		if( n++ )
+			w->buf[w->len++] = ',';
+		w->buf[w->len++] = '\"';
+		key = ht_get_key(he);
+		if( !_js_writer_escape(w,key,strlen(key)) )
 			return JS_ERR;
-		if( !_js_buffer_sprintf(buf,"\":") )
+		if( !JS_WRITER_ROOM(w,2) )
 			return JS_ERR;
+		w->buf[w->len++] = '\"';
+		w->buf[w->len++] = ':';
 
-		if( ht_get_val(he) ) {
-			jsObject *obj = ht_get_val(he);
-			if( !obj->print(obj,buf) )
-				return JS_ERR;
-		}
+		if( (sub = ht_get_val(he)) && !_js_object_print(sub,w) )
+			return JS_ERR;
 	}
-	ht_destroy_iterator(hi);
-	if( !_js_buffer_sprintf(buf,"}") )
-		return JS_ERR;
-	return JS_OK;
+	return _js_writer_char(w,'}');
 }
 
-static int _js_object_array_print(jsObject *obj, char **buf) {
-	int n = 0;
-	lsNode *ln;
-	lsIterator *li;
+static int _js_object_array_print(jsObject *obj, jsWriter *w) {
+	jsArray *a = obj->v.val;
+	jsObject *sub;
+	int i;
 
-	if( !buf || !buf[0] || !obj )
+	if( !_js_writer_char(w,'[') )
 		return JS_ERR;
+	for( i = 0; a && a->len > i; ++i ) {
+		if( i && !_js_writer_char(w,',') )
+			return JS_ERR;
+		if( (sub = a->item[i]) && !_js_object_print(sub,w) )
+			return JS_ERR;
+	}
+	return _js_writer_char(w,']');
+}
 
-	if( !_js_buffer_sprintf(buf,"[") )
+static int _js_object_string_print(jsObject *obj, jsWriter *w) {
+	if( !_js_writer_char(w,'\"') )
 		return JS_ERR;
-	li = ls_create_iterator(obj->v.val,LS_START_HEAD);
-	if( !li )
+	if( !_js_writer_escape(w,JS_OBJECT_STR(obj),obj->len) )
 		return JS_ERR;
-	while( (ln = ls_next(li)) ) {
-		if( n++ )
-			if( !_js_buffer_sprintf(buf,",") )
-				return JS_ERR;
+	return _js_writer_char(w,'\"');
+}
 
-		if( ls_value(ln) ) {
-			jsObject *obj = ls_value(ln);
-			if( !obj->print(obj,buf) )
-				return JS_ERR;
-		}
-	}
-	ls_destroy_iterator(li);
-	if( !_js_buffer_sprintf(buf,"]") )
+static int _js_object_number_print(jsObject *obj, jsWriter *w) {
+	char *num;
+	int len;
+
+	if( !JS_WRITER_ROOM(w,NM_DOUBLE_SIZE + 2) )
 		return JS_ERR;
+	num = w->buf + w->len;
+	if( obj->flags & JS_FLAG_DOUBLE ) {
+		if( !isfinite(obj->v.d64) )
+			return JS_ERR;
+		/* keep a fraction so that the value reads back as a double */
+		len = nm_dtoa(obj->v.d64,num);
+		if( !memchr(num,'.',len) && !memchr(num,'e',len) ) {
+			num[len++] = '.';
+			num[len++] = '0';
+		}
+	} else
+		len = nm_ltoa(obj->v.l64,num);
+	w->len += len;
 	return JS_OK;
 }
 
-static int _js_object_string_print(jsObject *obj, char **buf) {
-	if( !buf || !buf[0] || !obj )
-		return JS_ERR;
+static int _js_object_boolean_print(jsObject *obj, jsWriter *w) {
+	if( obj->v.l64 )
+		return _js_writer_put(w,"true",4);
+	return _js_writer_put(w,"false",5);
+}
 
-	if( !_js_buffer_sprintf(buf,"\"") )
-		return JS_ERR;
-	if( !_js_object_string_escape((char **)&obj->v.val) )
-		return JS_ERR;
-	if( !_js_buffer_sprintf(buf,obj->v.val) )
-		return JS_ERR;
-	if( !_js_buffer_sprintf(buf,"\"") )
+static int _js_object_null_print(jsObject *obj, jsWriter *w) {
+	(void)obj;
+	return _js_writer_put(w,"null",4);
+}
+
+// json writer
+static int _js_writer_flush(jsWriter *w) {
+	if( w->len && !w->flush(w->ud,w->buf,w->len) )
 		return JS_ERR;
+	w->len = 0;
 	return JS_OK;
 }
 
-static int _js_object_number_print(jsObject *obj, char **buf) {
-	if( !buf || !buf[0] || !obj )
+/* Makes room for n bytes, n being at most the chunk size when flushing. */
+static int _js_writer_grow(jsWriter *w, int n) {
+	jsBuffer *jbuf;
+	int size;
+
+	if( w->flush )
+		return _js_writer_flush(w);
+	if( INT_MAX / 2 <= w->size || INT_MAX / 2 <= n )
 		return JS_ERR;
 
-	if( obj->idouble ) {
-		if( 1.0e-6 > fabs(obj->v.d64) || 1.0e9 < fabs(obj->v.d64) ) {
-			if( !_js_buffer_sprintf(buf,"%e",obj->v.d64) )
-				return JS_ERR;
-		} else {
-			char *dec, *end;
-			char num[128]; num[0] = '\0';
-			snprintf(num,127,"%lf",obj->v.d64);
-
-			dec = strchr(num,'.');
-			if( dec ) {
-				end = num + strlen(num);
-				while( dec < --end ) {
-					if( '0' != end[0] || '.' == end[0] )
-						break;
-				}
-				if( '.' == (end++)[0] )
-					(end++)[0] = '0';
-				(end)[0] = '\0';
-			}
-			if( !_js_buffer_sprintf(buf,"%s",num) )
-				return JS_ERR;
-		}
-	} else {
-		if( !_js_buffer_sprintf(buf,"%ld",obj->v.l64) )
+	size = JS_MAX(w->size * 2,w->len + n);
+	jbuf = realloc(w->buf - sizeof(*jbuf),sizeof(*jbuf) + size + 1);
+	if( !jbuf )
+		return JS_ERR;
+	w->buf = jbuf->buf;
+	w->size = size;
+	return JS_OK;
+}
+
+static int _js_writer_put(jsWriter *w, const char *str, int len) {
+	int n;
+
+	while( w->size - w->len < len ) {
+		if( !w->flush )
+			return _js_writer_grow(w,len) && _js_writer_put(w,str,len);
+		n = w->size - w->len;
+		memcpy(w->buf + w->len,str,n);
+		w->len += n;
+		str += n;
+		len -= n;
+		if( !_js_writer_flush(w) )
 			return JS_ERR;
 	}
+	memcpy(w->buf + w->len,str,len);
+	w->len += len;
 	return JS_OK;
 }
 
-static int _js_object_boolean_print(jsObject *obj, char **buf) {
-	if( !buf || !buf[0] || !obj )
+static int _js_writer_char(jsWriter *w, char c) {
+	if( !JS_WRITER_ROOM(w,1) )
 		return JS_ERR;
+	w->buf[w->len++] = c;
+	return JS_OK;
+}
+
+/* Second character of the escape of each byte, 0 when it prints as is. */
+static const char jsEscape[256] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	0, 0, '\"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0
+};
+
+/* Length of the leading run of str that needs no escaping. */
+static int _js_writer_span(const char *str, int len) {
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i q = _mm_set1_epi8('\"'), b = _mm_set1_epi8('\\');
+	const __m128i ctl = _mm_set1_epi8(0x1f);
+	__m128i x;
+	int m;
+
+	for( ; len - i >= 16; i += 16 ) {
+		x = _mm_loadu_si128((const __m128i *)(str + i));
+		m = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(x,q),_mm_cmpeq_epi8(x,b)),
+			_mm_cmpeq_epi8(_mm_max_epu8(x,ctl),ctl)));
+		if( m )
+			return i + __builtin_ctz(m);
+	}
+#endif
+	while( len > i && !jsEscape[(unsigned char)str[i]] )
+		i++;
+	return i;
+}
 
-	if( obj->v.l64 ) {
-		if( !_js_buffer_sprintf(buf,"true") )
+static int _js_writer_escape(jsWriter *w, const char *str, int len) {
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+	char *p;
+	int n;
+
+	while( 0 < len ) {
+		n = _js_writer_span(str,len);
+		if( n && !_js_writer_put(w,str,n) )
 			return JS_ERR;
-	} else {
-		if( !_js_buffer_sprintf(buf,"false") )
+		if( len == n )
+			break;
+		if( !JS_WRITER_ROOM(w,6) )
 			return JS_ERR;
+		c = (unsigned char)str[n];
+		p = w->buf + w->len;
+		p[0] = '\\';
+		p[1] = jsEscape[c];
+		if( 'u' == p[1] ) {
+			p[2] = '0';
+			p[3] = '0';
+			p[4] = hex[c >> 4];
+			p[5] = hex[c & 15];
+			w->len += 6;
+		} else
+			w->len += 2;
+		str += n + 1;
+		len -= n + 1;
 	}
 	return JS_OK;
 }
 
-static int _js_object_null_print(jsObject *obj, char **buf) {
-	if( !buf || !buf[0] || !obj )
-		return JS_ERR;
+static int _js_writer_fd(void *ud, const char *buf, int len) {
+	int fd = *(int *)ud;
+	ssize_t n;
 
-	if( !_js_buffer_sprintf(buf,"null") )
-		return JS_ERR;
+	while( 0 < len ) {
+		if( 0 > (n = write(fd,buf,len)) ) {
+			if( EINTR == errno )
+				continue;
+			return JS_ERR;
+		}
+		buf += n;
+		len -= n;
+	}
 	return JS_OK;
 }
 
 // json parse
-static const char *_js_skip(const char *in) {
-	while( in && in[0] && 32 >= ((unsigned char *)in)[0] )
-		in++;
-	return in;
+static int _js_hex4(const char *in) {
+	int i, c, v = 0;
+	for( i = 0; 4 > i; ++i ) {
+		c = (unsigned char)in[i];
+		if( '0' <= c && '9' >= c )
+			c -= '0';
+		else if( 'a' <= (c | 0x20) && 'f' >= (c | 0x20) )
+			c = (c | 0x20) - 'a' + 10;
+		else
+			return -1;
+		v = (v << 4) | c;
+	}
+	return v;
 }
 
-static const char *_js_string_escape(const char *in, int *pos) {
-	const char *val = in;
-	char *out;
-	char *str;
-	int len = 0;
-
-	while( '\"' != val[0] && val[0] && ++len && ++pos[0] )
-		if( '\\' == (val++)[0] )
-			val++, pos[0]++;
-
-	str = _js_buffer_newlen(len);
-	if( !str  )
-		return NULL;
-
-	val = in;
-	out = str;
-
-	while( '\"' != val[0] && val[0] ) {
-		if( '\\' != val[0] )
-			(out++)[0] = (val++)[0];
-		else {
-			val++;
-			switch(val[0]) {
-			case 'b':
-				(out++)[0] = '\b';
-				break;
-			case 'f':
-				(out++)[0] = '\f';
-				break;
-			case 'n':
-				(out++)[0] = '\n';
-				break;
-			case 'r':
-				(out++)[0] = '\r';
-				break;
-			case 't':
-				(out++)[0] = '\t';
-				break;
-			default:
-				(out++)[0] = val[0];
+/* Decodes len raw bytes of a string body. The output is never longer than
+ * the input, so out may equal in. Returns the decoded length or -1. */
+static int _js_string_decode(char *out, const char *in, int len) {
+	const char *end = in + len;
+	char *o = out;
+	int u, l;
+
+	while( in < end ) {
+		if( '\\' != in[0] ) {
+			(o++)[0] = (in++)[0];
+			continue;
+		}
+		switch( (++in)[0] ) {
+		case 'b':
+			(o++)[0] = '\b';
+			break;
+		case 'f':
+			(o++)[0] = '\f';
+			break;
+		case 'n':
+			(o++)[0] = '\n';
+			break;
+		case 'r':
+			(o++)[0] = '\r';
+			break;
+		case 't':
+			(o++)[0] = '\t';
+			break;
+		case 'u':
+			if( 5 > end - in || 0 > (u = _js_hex4(in + 1)) )
+				return -1;
+			in += 4;
+			if( 0xd800 <= u && 0xdbff >= u && 7 <= end - in && '\\' == in[1] && 'u' == in[2] &&
+				0xdc00 <= (l = _js_hex4(in + 3)) && 0xdfff >= l ) {
+				u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+				in += 6;
+			}
+			if( 0x80 > u )
+				(o++)[0] = u;
+			else if( 0x800 > u ) {
+				(o++)[0] = 0xc0 | (u >> 6);
+				(o++)[0] = 0x80 | (u & 0x3f);
+			} else if( 0x10000 > u ) {
+				(o++)[0] = 0xe0 | (u >> 12);
+				(o++)[0] = 0x80 | ((u >> 6) & 0x3f);
+				(o++)[0] = 0x80 | (u & 0x3f);
+			} else {
+				(o++)[0] = 0xf0 | (u >> 18);
+				(o++)[0] = 0x80 | ((u >> 12) & 0x3f);
+				(o++)[0] = 0x80 | ((u >> 6) & 0x3f);
+				(o++)[0] = 0x80 | (u & 0x3f);
 			}
-			val++;
+			break;
+		default:
+			(o++)[0] = in[0];
 		}
+		in++;
 	}
-	out[0] = '\0';
-	return str;
-}
-
-static const char *_js_parse_value(jsObject *obj, const char *value, const char **pos) {
-	if( !value )
-		return NULL;
-	if( !strncmp(value,"null",4) ) {
-		_js_object_set_null(obj);
-		return value + 4;
-	}
-	if( !strncmp(value,"false",5) ) {
-		_js_object_set_bool(obj,JS_FALSE);
-		return value + 5;
-	}
-	if( !strncmp(value,"true",4) ) {
-		_js_object_set_bool(obj,JS_TRUE);
-		return value + 4;
-	}
-	if( '\"' == value[0] )
-		return _js_parse_string(obj,value);
-	if( '-' == value[0] || ('0' <= value[0] && '9' >= value[0]) )
-		return _js_parse_number(obj,value);
-	if( '[' == value[0] )
-		return _js_parse_array(obj,value,pos);
-	if( '{' == value[0] )
-		return _js_parse_object(obj,value,pos);
-	pos[0] = value;
-	return NULL;
+	return o - out;
 }
 
-static const char *_js_parse_name(jsObject *obj, const char *value, const char **pos) {
-	const char *val = value + 1;
-	int len = 0;
+static const char *_js_parse_number(jsParser *ps, const char *value) {
+	const char *end;
+	double d;
+	long l;
+	int r;
 
-	if( '\"' != value[0] ) {
-		pos[0] = value;
-		return NULL;
+	switch( nm_strtonum(value,&end,&l,&d) ) {
+	case NM_LONG:
+		r = JS_SAX_CALL(ps,integer,l);
+		break;
+	case NM_DOUBLE:
+		/* JSON has no spelling for the infinity an overflow gives */
+		r = isfinite(d) ? JS_SAX_CALL(ps,number,d) : JS_ERR;
+		break;
+	default:
+		r = JS_ERR;
 	}
-	obj->name = (char *)_js_string_escape(val,&len);
-	if( !obj->name )
+	if( !r ) {
+		ps->err = value;
 		return NULL;
-	val += len;
-	if( '\"' == val[0] )
-		val++;
-	return val;
+	}
+	return end;
 }
 
-static const char *_js_parse_string(jsObject *obj, const char *value) {
-	const char *val = value + 1;
-	char *str;
-	int len = 0;
-
-	str = (char *)_js_string_escape(val,&len);
-	if( !str )
-		return NULL;
-	val += len;
-	if( '\"' == val[0] )
-		val++;
-	_js_object_set_string(obj,str);
-	return val;
-}
-
-static const char *_js_parse_number(jsObject *obj, const char *value) {
-	double num = 0, sign = 1, scale = 0;
-	int subscale = 0, signsubscale = 1;
-
-	if( '-' == value[0] )
-		sign = -1, value++;
-	if( '0' == value[0] )
-		value++;
-	if( '1' <= value[0] && '9' >= value[0] )
-		do {
-			num = (num * 10.0) + ((value++)[0] - '0');
-		} while( '0' <= value[0] && '9' >= value[0] );
-	if( '.' == value[0] && '0' <= value[1] && '9' >= value[1] ) {
-		value++;
-		do {
-			num = (num * 10.0) + ((value++)[0] -'0'), scale--;
-		} while( '0' <= value[0] && '9' >= value[0] );
-	}
-	if( 'e' == value[0] || 'E' == value[0] ) {
-		value++;
-		if( '+' == value[0] )
-			value++;
-		else if( '-' == value[0] )
-			signsubscale = -1, value++;
-		while( '0' <= value[0] && '9' >= value[0] )
-			subscale = (subscale * 10) + ((value++)[0] -'0');
-	}
-	num = sign * num * pow(10.0,(scale + subscale * signsubscale));
-
-	if( !scale )
-		_js_object_set_number(obj,num,0);
-	else
-		_js_object_set_number(obj,num,1);
-	return value;
+// json index
+#if defined(__SSE2__)
+static void _js_classify_sse2(const char *p, jsBlock *m) {
+	const __m128i q = _mm_set1_epi8('\"'), b = _mm_set1_epi8('\\');
+	const __m128i lo = _mm_set1_epi8('{'), hi = _mm_set1_epi8('}');
+	const __m128i colon = _mm_set1_epi8(':'), comma = _mm_set1_epi8(',');
+	const __m128i sp = _mm_set1_epi8(' '), bit = _mm_set1_epi8(0x20);
+	__m128i x, y;
+	int i;
+
+	m->quote = m->bslash = m->op = m->ws = 0;
+	for( i = 0; 64 > i; i += 16 ) {
+		x = _mm_loadu_si128((const __m128i *)(p + i));
+		y = _mm_or_si128(x,bit);
+		m->quote |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x,q)) << i;
+		m->bslash |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x,b)) << i;
+		m->op |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(y,lo),_mm_cmpeq_epi8(y,hi)),
+			_mm_or_si128(_mm_cmpeq_epi8(x,colon),_mm_cmpeq_epi8(x,comma)))) << i;
+		m->ws |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x,sp),sp)) << i;
+	}
+}
+#endif
+
+#if defined(JS_AVX2)
+__attribute__((target("avx2")))
+static void _js_classify_avx2(const char *p, jsBlock *m) {
+	const __m256i q = _mm256_set1_epi8('\"'), b = _mm256_set1_epi8('\\');
+	const __m256i lo = _mm256_set1_epi8('{'), hi = _mm256_set1_epi8('}');
+	const __m256i colon = _mm256_set1_epi8(':'), comma = _mm256_set1_epi8(',');
+	const __m256i sp = _mm256_set1_epi8(' '), bit = _mm256_set1_epi8(0x20);
+	__m256i x, y;
+	int i;
+
+	m->quote = m->bslash = m->op = m->ws = 0;
+	for( i = 0; 64 > i; i += 32 ) {
+		x = _mm256_loadu_si256((const __m256i *)(p + i));
+		y = _mm256_or_si256(x,bit);
+		m->quote |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,q)) << i;
+		m->bslash |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,b)) << i;
+		m->op |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(y,lo),_mm256_cmpeq_epi8(y,hi)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(x,colon),_mm256_cmpeq_epi8(x,comma)))) << i;
+		m->ws |= (uint64_t)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(x,sp),sp)) << i;
+	}
+}
+#endif
+
+/* '{' and '[' as well as '}' and ']' differ only in bit 0x20. Every byte
+ * up to the space counts as whitespace, as the parser always did. */
+static void _js_classify(const char *p, jsBlock *m) {
+#if defined(JS_AVX2)
+	/* parse threads may race here; the check is idempotent */
+	static int avx2 = -1;
+	int v = __atomic_load_n(&avx2,__ATOMIC_RELAXED);
+	if( 0 > v ) {
+		v = __builtin_cpu_supports("avx2") ? 1 : 0;
+		__atomic_store_n(&avx2,v,__ATOMIC_RELAXED);
+	}
+	if( v ) {
+		_js_classify_avx2(p,m);
+		return;
+	}
+#endif
+#if defined(__SSE2__)
+	_js_classify_sse2(p,m);
+#else
+	unsigned char c;
+	int i;
+
+	m->quote = m->bslash = m->op = m->ws = 0;
+	for( i = 0; 64 > i; ++i ) {
+		c = (unsigned char)p[i];
+		if( '\"' == c )
+			m->quote |= (uint64_t)1 << i;
+		else if( '\\' == c )
+			m->bslash |= (uint64_t)1 << i;
+		else if( '{' == (c | 0x20) || '}' == (c | 0x20) || ':' == c || ',' == c )
+			m->op |= (uint64_t)1 << i;
+		else if( ' ' >= c )
+			m->ws |= (uint64_t)1 << i;
+	}
+#endif
 }
 
-static const char *_js_parse_array(jsObject *obj, const char *value, const char **pos) {
-	lsHandle *ls;
-	jsObject *sub;
-
-	ls = ls_create(&lsTypeJson);
-	if( !ls )
-		return NULL;
-	_js_object_set_array(obj,ls);
+/* Bits of the characters preceded by an odd run of backslashes. carry
+ * holds whether the previous block ended inside such a run. */
+static uint64_t _js_odd_escapes(uint64_t bs, uint64_t *carry) {
+	const uint64_t even = 0x5555555555555555ULL, odd = ~even;
+	uint64_t starts = bs & ~(bs << 1);
+	uint64_t even_mask = even ^ carry[0];
+	uint64_t even_starts = starts & even_mask;
+	uint64_t odd_starts = starts & ~even_mask;
+	uint64_t even_carries = bs + even_starts;
+	uint64_t odd_carries;
+	int over = __builtin_add_overflow(bs,odd_starts,&odd_carries);
+
+	odd_carries |= carry[0];
+	carry[0] = over ? 1 : 0;
+	even_carries &= ~bs;
+	odd_carries &= ~bs;
+	return (even_carries & odd) | (odd_carries & even);
+}
 
-	value = _js_skip(value + 1);
-	if( ']' == value[0] )
-		return value + 1;
+static uint64_t _js_prefix_xor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
 
-	sub = _js_object_new();
-	if( !sub )
-		return NULL;
+static void _js_index_init(jsIndex *ix, const char *buf, int len) {
+	ix->buf = buf;
+	ix->len = len;
+	ix->base = 0;
+	ix->esc = 0;
+	ix->in = 0;
+	ix->term = (uint64_t)1 << 63;
+	ix->n = 0;
+	ix->i = 0;
+}
 
-	if( !_js_object_add_object(obj,sub) ) {
-		JS_OBJECT_FREE(sub);
-		return NULL;
-	}
+/* Stage one: offsets of every structural character, of both quotes of
+ * each string and of the first byte of each number or literal, in order.
+ * Indexes blocks until the window may not hold another one; returns the
+ * number of entries, 0 once the input is used up. */
+static int _js_index_fill(jsIndex *ix) {
+	uint64_t quote, str, prev, bits;
+	char tail[64];
+	const char *p;
+	jsBlock m;
+
+	ix->n = ix->i = 0;
+	for( ; ix->len > ix->base && sizeof(ix->idx) / sizeof(ix->idx[0]) - 64 >= (unsigned int)ix->n; ix->base += 64 ) {
+		p = ix->buf + ix->base;
+		if( 64 > ix->len - ix->base ) {
+			memset(tail,' ',sizeof(tail));
+			memcpy(tail,p,ix->len - ix->base);
+			p = tail;
+		}
+		_js_classify(p,&m);
 
-	value = _js_skip(_js_parse_value(sub,_js_skip(value),pos));
-	if( !value )
-		return NULL;
+		quote = m.quote & ~_js_odd_escapes(m.bslash,&ix->esc);
+		str = _js_prefix_xor(quote) ^ ix->in;
+		ix->in = (uint64_t)((int64_t)str >> 63);
 
-	while( ',' == value[0] ) {
-		sub = _js_object_new();
-		if( !sub )
-			return NULL;
+		prev = ix->term;
+		ix->term = m.op | m.ws | quote;
+		bits = ~ix->term & ~str & ((ix->term << 1) | (prev >> 63));
+		bits |= (m.op & ~str) | quote;
 
-		if( !_js_object_add_object(obj,sub) ) {
-			JS_OBJECT_FREE(sub);
-			return NULL;
+		while( bits ) {
+			ix->idx[ix->n++] = ix->base + __builtin_ctzll(bits);
+			bits &= bits - 1;
 		}
-
-		value = _js_skip(_js_parse_value(sub,_js_skip(value + 1),pos));
-		if( !value )
-			return NULL;
 	}
-	if( ']' == value[0] )
-		return value + 1;
-	pos[0] = value;
-	return NULL;
+	return ix->n;
 }
 
-static const char *_js_parse_object(jsObject *obj, const char *value, const char **pos) {
-	htHandle *ht;
-	jsObject *sub;
-
-	ht = ht_create(&htTypeJson);
-	if( !ht )
+/* The next structural position, or NULL at the end of the input. An
+ * unterminated string shows up as an opening quote with no entry after
+ * it. */
+static char *_js_index_next(jsIndex *ix) {
+	if( ix->n == ix->i && !_js_index_fill(ix) )
 		return NULL;
-	_js_object_set_object(obj,ht);
+	return (char *)ix->buf + ix->idx[ix->i++];
+}
 
-	value = _js_skip(value + 1);
-	if( '}' == value[0] )
-		return value + 1;
+// json builder
+static void _js_build_init(jsBuilder *b, jsParser *ps) {
+	b->ps = ps;
+	b->root = NULL;
+	b->stack = b->inl;
+	b->depth = 0;
+	b->size = sizeof(b->inl) / sizeof(b->inl[0]);
+	b->vals = NULL;
+	b->nval = b->vsize = 0;
+	b->key = NULL;
+	ps->ud = b;
+}
 
-	sub = _js_object_new();
-	if( !sub )
-		return NULL;
+/* Elements still waiting in vals belong to arrays that never closed and
+ * hence to no document. */
+static void _js_build_release(jsBuilder *b) {
+	if( b->stack != b->inl )
+		JS_FREE(b->stack);
+	b->stack = b->inl;
+	while( 0 < b->nval ) {
+		b->nval--;
+		JS_PARSER_FREE(b->ps,b->vals[b->nval]);
+	}
+	JS_FREE(b->vals);
+	b->vsize = 0;
+	if( !b->ps->pool && !b->ps->insitu && !b->ps->dict )
+		JS_BUFER_FREE(b->key);
+	b->key = NULL;
+}
 
-	value = _js_skip(_js_parse_name(obj,_js_skip(value),pos));
-	if( !value ) {
-		JS_OBJECT_FREE(sub);
-		return NULL;
+static int _js_build_push(jsBuilder *b, jsObject *obj) {
+	jsObject **stack;
+	if( b->depth == b->size ) {
+		if( b->stack == b->inl ) {
+			if( !(stack = malloc(b->size * 2 * sizeof(*stack))) )
+				return JS_ERR;
+			memcpy(stack,b->inl,sizeof(b->inl));
+		} else if( !(stack = realloc(b->stack,b->size * 2 * sizeof(*stack))) )
+			return JS_ERR;
+		b->stack = stack;
+		b->size *= 2;
 	}
+	b->stack[b->depth++] = obj;
+	return JS_OK;
+}
 
-	if( !_js_object_add_object(obj,sub) ) {
-		JS_OBJECT_FREE(sub);
-		return NULL;
+static int _js_build_push_val(jsBuilder *b, jsObject *obj) {
+	jsObject **vals;
+	int size;
+	if( b->nval == b->vsize ) {
+		size = b->vsize ? b->vsize * 2 : 64;
+		if( !(vals = realloc(b->vals,size * sizeof(*vals))) )
+			return JS_ERR;
+		b->vals = vals;
+		b->vsize = size;
 	}
+	b->vals[b->nval++] = obj;
+	return JS_OK;
+}
 
-	if( ':' != value[0] ) {
-		pos[0] = value;
-		return NULL;
+/* Hangs obj under the innermost open container, or makes it the root. On
+ * failure obj is released unless it lives in the pool. */
+static int _js_build_add(jsBuilder *b, jsObject *obj) {
+	jsObject *top;
+	if( 0 == b->depth ) {
+		if( !b->root ) {
+			b->root = obj;
+			return JS_OK;
+		}
+	} else if( JS_ARRAY == (top = b->stack[b->depth - 1])->type ) {
+		if( _js_build_push_val(b,obj) )
+			return JS_OK;
+	} else if( _js_object_add_object(top,b->key,obj) ) {
+		b->key = NULL;
+		return JS_OK;
 	}
+	JS_PARSER_FREE(b->ps,obj);
+	return JS_ERR;
+}
+
+static jsObject *_js_build_new(jsBuilder *b) {
+	return _js_object_new(b->ps->pool,b->ps->insitu);
+}
 
-	value = _js_skip(_js_parse_value(sub,_js_skip(value + 1),pos));
-	if( !value )
+static char *_js_build_str(jsBuilder *b, const char *str, int len) {
+	char *buf;
+	if( b->ps->insitu )
+		return (char *)str;
+	if( !(buf = _js_buffer_newlen(b->ps->pool,len)) )
 		return NULL;
+	memcpy(buf,str,len);
+	buf[len] = '\0';
+	return buf;
+}
 
-	while( ',' == value[0] ) {
-		sub = _js_object_new();
-		if( !sub )
-			return NULL;
+static int _js_build_container(jsBuilder *b, int type) {
+	jsParser *ps = b->ps;
+	jsObject *obj;
+	void *val;
 
-		value = _js_skip(_js_parse_name(obj,_js_skip(value + 1),pos));
-		if( !value ) {
-			JS_OBJECT_FREE(sub);
-			return NULL;
+	if( !(obj = _js_build_new(b)) )
+		return JS_ERR;
+	if( JS_OBJECT == type ) {
+		if( ps->dict && ps->pool )
+			val = ht_create_pool(&ps->dict->pool_type,ps->pool);
+		else if( ps->dict )
+			val = ht_create(&ps->dict->type);
+		else if( ps->pool )
+			val = ht_create_pool(&htTypeJsonPool,ps->pool);
+		else
+			val = ht_create(ps->insitu ? &htTypeJsonView : &htTypeJson);
+		if( !val ) {
+			JS_PARSER_FREE(ps,obj);
+			return JS_ERR;
 		}
+		_js_object_set_object(obj,val);
+	} else
+		_js_object_set_array(obj,NULL);
+	if( !_js_build_add(b,obj) )
+		return JS_ERR;
+	/* the array itself is made when it closes, till then len marks where
+	 * its elements start in vals */
+	if( JS_ARRAY == type )
+		obj->len = b->nval;
+	return _js_build_push(b,obj);
+}
 
-		if( !_js_object_add_object(obj,sub) ) {
-			JS_OBJECT_FREE(sub);
-			return NULL;
+static int _js_build_start_object(void *ud) {
+	return _js_build_container(ud,JS_OBJECT);
+}
+
+static int _js_build_start_array(void *ud) {
+	return _js_build_container(ud,JS_ARRAY);
+}
+
+static int _js_build_end(void *ud) {
+	jsBuilder *b = ud;
+	b->depth--;
+	return JS_OK;
+}
+
+static int _js_build_end_array(void *ud) {
+	jsBuilder *b = ud;
+	jsObject *obj = b->stack[--b->depth];
+	int n = b->nval - obj->len;
+
+	if( !(obj->v.val = _js_array_new(b->ps->pool,b->vals + obj->len,n)) )
+		return JS_ERR;
+	b->nval = obj->len;
+	obj->len = n;
+	return JS_OK;
+}
+
+/* Tables hash, compare and print keys as C strings, so a key with a
+ * decoded \u0000 in it is refused rather than cut short. */
+static int _js_build_key(void *ud, const char *str, int len) {
+	jsBuilder *b = ud;
+	if( memchr(str,'\0',len) )
+		return JS_ERR;
+	if( b->ps->dict )
+		b->key = _js_dict_intern(b->ps->dict,str,len);
+	else
+		b->key = _js_build_str(b,str,len);
+	if( !b->key )
+		return JS_ERR;
+	return JS_OK;
+}
+
+static int _js_build_string(void *ud, const char *str, int len) {
+	jsBuilder *b = ud;
+	jsObject *obj;
+	char *buf;
+
+	if( !(obj = _js_build_new(b)) )
+		return JS_ERR;
+	if( JS_INLINE_MAX >= len )
+		_js_object_set_inline(obj,str,len);
+	else if( (buf = _js_build_str(b,str,len)) )
+		_js_object_set_string(obj,buf,len);
+	else {
+		JS_PARSER_FREE(b->ps,obj);
+		return JS_ERR;
+	}
+	return _js_build_add(b,obj);
+}
+
+static int _js_build_integer(void *ud, long value) {
+	jsObject *obj;
+	if( !(obj = _js_build_new(ud)) )
+		return JS_ERR;
+	_js_object_set_integer(obj,value);
+	return _js_build_add(ud,obj);
+}
+
+static int _js_build_number(void *ud, double value) {
+	jsObject *obj;
+	if( !(obj = _js_build_new(ud)) )
+		return JS_ERR;
+	_js_object_set_number(obj,value);
+	return _js_build_add(ud,obj);
+}
+
+static int _js_build_boolean(void *ud, int value) {
+	jsObject *obj;
+	if( !(obj = _js_build_new(ud)) )
+		return JS_ERR;
+	_js_object_set_bool(obj,value);
+	return _js_build_add(ud,obj);
+}
+
+static int _js_build_null(void *ud) {
+	jsObject *obj;
+	if( !(obj = _js_build_new(ud)) )
+		return JS_ERR;
+	_js_object_set_null(obj);
+	return _js_build_add(ud,obj);
+}
+
+// json feed
+static void _js_feed_init(jsFeed *f, jsHandle *js, jsSax *sax, void *ud) {
+	memset(f,0,sizeof(*f));
+	f->ps.pool = js->pool;
+	f->ps.dict = js->dict;
+	f->ps.sax = &jsSaxBuild;
+	_js_build_init(&f->b,&f->ps);
+	if( sax ) {
+		f->ps.sax = sax;
+		f->ps.ud = ud;
+	}
+	f->state = JS_FEED_VALUE;
+}
+
+static void _js_feed_release(jsFeed *f) {
+	_js_build_release(&f->b);
+	JS_BUFER_FREE(f->ps.tmp);
+	JS_BUFER_FREE(f->tok);
+	JS_FREE(f->stack);
+}
+
+static jsFeed *_js_feed_new(jsHandle *js) {
+	jsFeed *f = malloc(sizeof(*f));
+	if( !f )
+		return NULL;
+	_js_feed_init(f,js,NULL,NULL);
+	if( !(f->tok = _js_buffer_new(JS_BUFFER_SIZE_INIT)) ) {
+		JS_FREE(f);
+		return NULL;
+	}
+	return f;
+}
+
+static void _js_feed_free(jsHandle *js) {
+	jsFeed *f = js->feed;
+	_js_feed_release(f);
+	JS_PARSER_FREE(&f->ps,f->b.root);
+	JS_FREE(js->feed);
+}
+
+static int _js_feed_open(jsFeed *f, int type) {
+	char *stack;
+	int r;
+
+	if( f->depth == f->size ) {
+		if( !(stack = realloc(f->stack,f->size * 2 + 16)) )
+			return JS_ERR;
+		f->stack = stack;
+		f->size = f->size * 2 + 16;
+	}
+	if( JS_OBJECT == type ) {
+		r = JS_SAX_CALL(&f->ps,start_object);
+		f->stack[f->depth++] = 'O';
+		f->state = JS_FEED_OBJECT_FIRST;
+	} else {
+		r = JS_SAX_CALL(&f->ps,start_array);
+		f->stack[f->depth++] = 'A';
+		f->state = JS_FEED_ARRAY_FIRST;
+	}
+	return r;
+}
+
+/* A value is complete: decide what the enclosing container expects. */
+static void _js_feed_close(jsFeed *f) {
+	if( 0 == f->depth )
+		f->state = JS_FEED_DONE;
+	else if( 'O' == f->stack[f->depth - 1] )
+		f->state = JS_FEED_OBJECT_NEXT;
+	else
+		f->state = JS_FEED_ARRAY_NEXT;
+}
+
+/* Hands over a complete string body. An escaped one is decoded where it
+ * lies when inplace, otherwise into the scratch buffer. */
+static int _js_feed_emit(jsFeed *f, char *str, int n, int esc, int inplace) {
+	jsParser *ps = &f->ps;
+	int r;
+
+	if( esc ) {
+		if( !inplace ) {
+			if( !ps->tmp && !(ps->tmp = _js_buffer_new(n)) )
+				return JS_ERR;
+			if( !(ps->tmp = _js_buffer_renew(ps->tmp,n)) )
+				return JS_ERR;
+			_js_buffer_clear(ps->tmp);
+			n = _js_string_decode(ps->tmp,str,n);
+			str = ps->tmp;
+		} else
+			n = _js_string_decode(str,str,n);
+		if( 0 > n )
+			return JS_ERR;
+	}
+	if( ps->insitu )
+		str[n] = '\0';
+	if( f->key ) {
+		r = JS_SAX_CALL(ps,key,str,n);
+		f->state = JS_FEED_OBJECT_COLON;
+	} else {
+		r = JS_SAX_CALL(ps,string,str,n);
+		_js_feed_close(f);
+	}
+	return r;
+}
+
+static int _js_feed_scalar(jsFeed *f, const char *p) {
+	const char *end;
+	int r = JS_ERR;
+
+	if( '-' == p[0] || ('0' <= p[0] && '9' >= p[0]) ) {
+		if( !(end = _js_parse_number(&f->ps,p)) )
+			return JS_ERR;
+		r = JS_OK;
+	} else if( !strncmp(p,"null",4) ) {
+		r = JS_SAX_CALL(&f->ps,null);
+		end = p + 4;
+	} else if( !strncmp(p,"true",4) ) {
+		r = JS_SAX_CALL(&f->ps,boolean,JS_TRUE);
+		end = p + 4;
+	} else if( !strncmp(p,"false",5) ) {
+		r = JS_SAX_CALL(&f->ps,boolean,JS_FALSE);
+		end = p + 5;
+	} else
+		return JS_ERR;
+	if( end[0] && 32 < (unsigned char)end[0] && !strchr(",:]}",end[0]) )
+		return JS_ERR;
+	_js_feed_close(f);
+	return r;
+}
+
+/* Stage two: runs the state machine over the structural index. The closing
+ * quote of a string is the entry right after its opening one. */
+static int _js_feed_index(jsFeed *f, char *buf, int len) {
+	jsIndex ix;
+	char *p, *q;
+	int r = JS_OK;
+
+	_js_index_init(&ix,buf,len);
+	while( r && (p = _js_index_next(&ix)) ) {
+		switch( f->state ) {
+		case JS_FEED_ARRAY_FIRST:
+			if( ']' == p[0] )
+				goto end_array;
+			/* fall through */
+		case JS_FEED_VALUE:
+			if( '{' == p[0] )
+				r = _js_feed_open(f,JS_OBJECT);
+			else if( '[' == p[0] )
+				r = _js_feed_open(f,JS_ARRAY);
+			else if( '\"' == p[0] ) {
+				f->key = 0;
+				goto string;
+			} else if( strchr(",:]}",p[0]) )
+				r = JS_ERR;
+			else
+				r = _js_feed_scalar(f,p);
+			break;
+		case JS_FEED_ARRAY_NEXT:
+			if( ',' == p[0] )
+				f->state = JS_FEED_VALUE;
+			else if( ']' == p[0] ) {
+end_array:
+				f->depth--;
+				r = JS_SAX_CALL(&f->ps,end_array);
+				_js_feed_close(f);
+			} else
+				r = JS_ERR;
+			break;
+		case JS_FEED_OBJECT_FIRST:
+			if( '}' == p[0] )
+				goto end_object;
+			/* fall through */
+		case JS_FEED_OBJECT_KEY:
+			if( '\"' != p[0] ) {
+				r = JS_ERR;
+				break;
+			}
+			f->key = 1;
+string:
+			if( !(q = _js_index_next(&ix)) ) {
+				r = JS_ERR;
+				break;
+			}
+			r = _js_feed_emit(f,p + 1,q - p - 1,NULL != memchr(p + 1,'\\',q - p - 1),f->ps.insitu);
+			break;
+		case JS_FEED_OBJECT_COLON:
+			if( ':' == p[0] )
+				f->state = JS_FEED_VALUE;
+			else
+				r = JS_ERR;
+			break;
+		case JS_FEED_OBJECT_NEXT:
+			if( ',' == p[0] )
+				f->state = JS_FEED_OBJECT_KEY;
+			else if( '}' == p[0] ) {
+end_object:
+				f->depth--;
+				r = JS_SAX_CALL(&f->ps,end_object);
+				_js_feed_close(f);
+			} else
+				r = JS_ERR;
+			break;
+		default:
+			r = JS_ERR;
+		}
+	}
+	if( r && JS_FEED_DONE != f->state ) {
+		p = buf + len;
+		r = JS_ERR;
+	}
+	if( !r )
+		f->ps.err = p;
+	return r;
+}
+
+static int _js_feed_string(jsFeed *f, const char *p, const char *end, const char **next) {
+	const char *q = p;
+	int r;
+
+	for( ; end > q; ++q ) {
+		if( f->bslash )
+			f->bslash = 0;
+		else if( '\\' == q[0] )
+			f->bslash = f->esc = 1;
+		else if( '\"' == q[0] )
+			break;
+	}
+	if( end == q || f->esc || _js_buffer_len(f->tok) ) {
+		if( !(f->tok = _js_buffer_cat(f->tok,p,q - p)) )
+			return JS_ERR;
+	}
+	if( end == q ) {
+		next[0] = q;
+		return JS_OK;
+	}
+
+	if( _js_buffer_len(f->tok) || f->esc )
+		r = _js_feed_emit(f,f->tok,_js_buffer_len(f->tok),f->esc,1);
+	else
+		r = _js_feed_emit(f,(char *)p,q - p,0,0);
+	_js_buffer_clear(f->tok);
+	f->esc = 0;
+	next[0] = q + 1;
+	return r;
+}
+
+/* Numbers and literals are short, so they are always gathered in tok and
+ * parsed once a delimiter shows up. */
+static int _js_feed_token(jsFeed *f, const char *p, const char *end, const char **next) {
+	const char *q = p;
+
+	if( JS_FEED_NUMBER == f->state )
+		while( end > q && (('0' <= q[0] && '9' >= q[0]) || strchr("+-.eE",q[0])) && q[0] )
+			q++;
+	else
+		while( end > q && 'a' <= q[0] && 'z' >= q[0] )
+			q++;
+	if( !(f->tok = _js_buffer_cat(f->tok,p,q - p)) )
+		return JS_ERR;
+	next[0] = q;
+	if( end == q )
+		return JS_OK;
+	return _js_feed_token_end(f);
+}
+
+static int _js_feed_token_end(jsFeed *f) {
+	const char *tok = f->tok;
+	int len = _js_buffer_len(f->tok), r = JS_ERR;
+
+	if( JS_FEED_NUMBER == f->state ) {
+		if( _js_parse_number(&f->ps,tok) == tok + len )
+			r = JS_OK;
+	} else if( 4 == len && !memcmp(tok,"null",4) )
+		r = JS_SAX_CALL(&f->ps,null);
+	else if( 4 == len && !memcmp(tok,"true",4) )
+		r = JS_SAX_CALL(&f->ps,boolean,JS_TRUE);
+	else if( 5 == len && !memcmp(tok,"false",5) )
+		r = JS_SAX_CALL(&f->ps,boolean,JS_FALSE);
+	_js_buffer_clear(f->tok);
+	_js_feed_close(f);
+	return r;
+}
+
+static int _js_feed(jsHandle *js, const char *chunk, int len) {
+	const char *p = chunk, *end = chunk + len;
+	jsFeed *f = js->feed;
+	int r = JS_OK;
+
+	if( !f && !(f = js->feed = _js_feed_new(js)) )
+		return JS_ERR;
+	if( JS_FEED_ERROR == f->state )
+		return JS_ERR;
+
+	while( end > p && r ) {
+		switch( f->state ) {
+		case JS_FEED_STRING:
+			r = _js_feed_string(f,p,end,&p);
+			continue;
+		case JS_FEED_NUMBER:
+		case JS_FEED_LITERAL:
+			r = _js_feed_token(f,p,end,&p);
+			continue;
+		}
+		if( 32 >= (unsigned char)p[0] ) {
+			p++;
+			continue;
+		}
+		switch( f->state ) {
+		case JS_FEED_ARRAY_FIRST:
+			if( ']' == p[0] )
+				goto end_array;
+			/* fall through */
+		case JS_FEED_VALUE:
+			if( '{' == p[0] )
+				r = _js_feed_open(f,JS_OBJECT);
+			else if( '[' == p[0] )
+				r = _js_feed_open(f,JS_ARRAY);
+			else if( '\"' == p[0] ) {
+				f->state = JS_FEED_STRING;
+				f->key = 0;
+			} else if( '-' == p[0] || ('0' <= p[0] && '9' >= p[0]) ) {
+				f->state = JS_FEED_NUMBER;
+				continue;
+			} else if( 'a' <= p[0] && 'z' >= p[0] ) {
+				f->state = JS_FEED_LITERAL;
+				continue;
+			} else
+				r = JS_ERR;
+			break;
+		case JS_FEED_ARRAY_NEXT:
+			if( ',' == p[0] )
+				f->state = JS_FEED_VALUE;
+			else if( ']' == p[0] ) {
+end_array:
+				f->depth--;
+				r = JS_SAX_CALL(&f->ps,end_array);
+				_js_feed_close(f);
+			} else
+				r = JS_ERR;
+			break;
+		case JS_FEED_OBJECT_FIRST:
+			if( '}' == p[0] )
+				goto end_object;
+			/* fall through */
+		case JS_FEED_OBJECT_KEY:
+			if( '\"' == p[0] ) {
+				f->state = JS_FEED_STRING;
+				f->key = 1;
+			} else
+				r = JS_ERR;
+			break;
+		case JS_FEED_OBJECT_COLON:
+			if( ':' == p[0] )
+				f->state = JS_FEED_VALUE;
+			else
+				r = JS_ERR;
+			break;
+		case JS_FEED_OBJECT_NEXT:
+			if( ',' == p[0] )
+				f->state = JS_FEED_OBJECT_KEY;
+			else if( '}' == p[0] ) {
+end_object:
+				f->depth--;
+				r = JS_SAX_CALL(&f->ps,end_object);
+				_js_feed_close(f);
+			} else
+				r = JS_ERR;
+			break;
+		default:
+			r = JS_ERR;
 		}
+		p++;
+	}
+	if( !r ) {
+		f->state = JS_FEED_ERROR;
+		js->err = (void *)p;
+	}
+	return r;
+}
 
-		if( ':' != value[0] ) {
-			pos[0] = value;
-			return NULL;
+static int _js_finish(jsHandle *js) {
+	jsFeed *f = js->feed;
+	int r = JS_ERR;
+
+	if( !f )
+		return JS_ERR;
+	if( JS_FEED_NUMBER == f->state || JS_FEED_LITERAL == f->state )
+		if( !_js_feed_token_end(f) )
+			f->state = JS_FEED_ERROR;
+	if( JS_FEED_DONE == f->state && JS_OBJECT == f->b.root->type ) {
+		js->obj = f->b.root;
+		f->b.root = NULL;
+		r = JS_TRUE;
+	}
+	_js_feed_free(js);
+	return r;
+}
+
+// json path
+static int _js_path_index(const char *str, int len) {
+	int i, index = 0;
+
+	if( 0 == len || (1 < len && '0' == str[0]) )
+		return JS_INV;
+	for( i = 0; len > i; i++ ) {
+		if( '0' > str[i] || '9' < str[i] || (INT_MAX - (str[i] - '0')) / 10 < index )
+			return JS_INV;
+		index = index * 10 + str[i] - '0';
+	}
+	return index;
+}
+
+static void _js_path_key(jsStep *step, int len) {
+	step->hash = _js_hash_function(step->key);
+	step->index = _js_path_index(step->key,len);
+}
+
+/* Room for the worst case of len bytes: a step and two key bytes each. */
+static jsPath *_js_path_new(int len) {
+	jsPath *path;
+
+	if( (INT_MAX - (int)sizeof(*path)) / ((int)sizeof(jsStep) + 2) <= len )
+		return NULL;
+	if( !(path = malloc(sizeof(*path) + (len + 1) * (sizeof(jsStep) + 2))) )
+		return NULL;
+	path->n = 0;
+	return path;
+}
+
+static jsPath *_js_pointer_compile(const char *str) {
+	jsPath *path;
+	jsStep *step;
+	char *key;
+	int len = strlen(str);
+
+	if( '\0' != *str && '/' != *str )
+		return NULL;
+	if( !(path = _js_path_new(len)) )
+		return NULL;
+	key = (char *)(path->step + len + 1);
+	while( '/' == *str ) {
+		step = path->step + path->n++;
+		step->key = key;
+		for( str++; '\0' != *str && '/' != *str; str++ ) {
+			if( '~' != *str )
+				*key++ = *str;
+			else if( '0' == str[1] || '1' == str[1] )
+				*key++ = '0' == *++str ? '~' : '/';
+			else {
+				JS_FREE(path);
+				return NULL;
+			}
 		}
+		*key = '\0';
+		_js_path_key(step,key - step->key);
+		key++;
+	}
+	return path;
+}
+
+/* Dotted paths: names joined by '.', array indices as [n], '\' escapes
+ * the next byte of a name, e.g. a.b[2].c or [0].x\.y. */
+static jsPath *_js_path_compile(const char *str) {
+	jsPath *path;
+	jsStep *step;
+	char *key;
+	const char *p;
+	int len = strlen(str);
 
-		value = _js_skip(_js_parse_value(sub,_js_skip(value + 1),pos));
-		if( !value )
+	if( !(path = _js_path_new(len)) )
+		return NULL;
+	key = (char *)(path->step + len + 1);
+	while( str && '\0' != *str ) {
+		step = path->step + path->n++;
+		if( '[' == *str ) {
+			step->key = NULL;
+			if( !(p = strchr(++str,']')) || 0 > (step->index = _js_path_index(str,p - str)) )
+				str = NULL;
+			else
+				str = p + 1;
+			continue;
+		}
+		if( 1 < path->n && '.' != *str++ ) {
+			str = NULL;
+			break;
+		}
+		step->key = key;
+		for( ; '\0' != *str && '.' != *str && '[' != *str; str++ ) {
+			if( '\\' == *str && '\0' == *++str ) {
+				key = step->key;
+				break;
+			}
+			*key++ = *str;
+		}
+		if( key == step->key ) {
+			str = NULL;
+			break;
+		}
+		*key = '\0';
+		_js_path_key(step,key - step->key);
+		step->index = JS_INV;
+		key++;
+	}
+	if( !str )
+		JS_FREE(path);
+	return path;
+}
+
+static jsObject *_js_path_get(jsPath *path, jsObject *obj) {
+	jsStep *step = path->step, *end = step + path->n;
+	htEntry *he;
+	jsArray *a;
+
+	for( ; obj && end > step; step++ ) {
+		if( JS_OBJECT == obj->type && step->key ) {
+			he = ht_find_hash(obj->v.val,step->key,step->hash);
+			obj = he ? ht_get_val(he) : NULL;
+		} else if( JS_ARRAY == obj->type && 0 <= step->index ) {
+			a = obj->v.val;
+			obj = a->len > step->index ? a->item[step->index] : NULL;
+		} else
 			return NULL;
 	}
-	if( '}' == value[0] )
-		return value + 1;
-	pos[0] = value;
+	return obj;
+}
+
+// json merge
+/* Equal values print the same, so 1 and 1.0 differ. */
+static int _js_equal(jsObject *a, jsObject *b) {
+	htIterator hi;
+	htEntry *he, *bhe;
+	jsArray *aa, *ba;
+	int i;
+
+	if( a->type != b->type )
+		return JS_FALSE;
+	switch( a->type ) {
+	case JS_OBJECT:
+		if( ht_size((htHandle *)a->v.val) != ht_size((htHandle *)b->v.val) )
+			return JS_FALSE;
+		ht_init_iterator(a->v.val,&hi);
+		while( (he = ht_next(&hi)) ) {
+			bhe = ht_find_hash(b->v.val,ht_get_key(he),he->hash);
+			if( !bhe || !_js_equal(ht_get_val(he),ht_get_val(bhe)) )
+				return JS_FALSE;
+		}
+		return JS_TRUE;
+	case JS_ARRAY:
+		aa = a->v.val;
+		ba = b->v.val;
+		if( aa->len != ba->len )
+			return JS_FALSE;
+		for( i = 0; aa->len > i; i++ )
+			if( !_js_equal(aa->item[i],ba->item[i]) )
+				return JS_FALSE;
+		return JS_TRUE;
+	case JS_STRING:
+		return a->len == b->len && 0 == memcmp(JS_OBJECT_STR(a),JS_OBJECT_STR(b),a->len);
+	case JS_NUMBER:
+		if( (a->flags ^ b->flags) & JS_FLAG_DOUBLE )
+			return JS_FALSE;
+		if( a->flags & JS_FLAG_DOUBLE )
+			return a->v.d64 == b->v.d64;
+		return a->v.l64 == b->v.l64;
+	case JS_BOOLEAN:
+		return a->v.l64 == b->v.l64;
+	}
+	return JS_TRUE;
+}
+
+/* Members only move between tables that free keys and values the same
+ * way: both from one pool, both in situ or both malloc'd. */
+static int _js_merge_domain(jsObject *obj, jsObject *patch) {
+	htHandle *a, *b;
+
+	if( !obj || !patch || JS_OBJECT != obj->type || JS_OBJECT != patch->type )
+		return JS_ERR;
+	a = obj->v.val;
+	b = patch->v.val;
+	return a->type == b->type && a->pool == b->pool;
+}
+
+/* Moves the member phe of pht into ht, over the entry he if there is one,
+ * and drops phe from pht. */
+static int _js_merge_move(htHandle *ht, htEntry *he, htHandle *pht, htEntry *phe) {
+	if( he ) {
+		ht_free_val(ht,he);
+		ht_get_val(he) = ht_get_val(phe);
+	} else if( !ht_add_hash(ht,ht_get_key(phe),phe->hash,ht_get_val(phe)) )
+		return JS_ERR;
+	else
+		ht_get_key(phe) = NULL;
+	ht_get_val(phe) = NULL;
+	ht_delete(pht,phe);
+	return JS_OK;
+}
+
+/* A patch object landing where there was no object is merged into an
+ * empty one, which only drops its null members. */
+static void _js_merge_strip(jsObject *obj) {
+	htIterator hi;
+	htEntry *he;
+	jsObject *sub;
+
+	ht_init_iterator(obj->v.val,&hi);
+	while( (he = ht_next(&hi)) ) {
+		sub = ht_get_val(he);
+		if( JS_NULL == sub->type )
+			ht_delete(obj->v.val,he);
+		else if( JS_OBJECT == sub->type )
+			_js_merge_strip(sub);
+	}
+}
+
+static int _js_merge_object(jsObject *obj, jsObject *patch, int *changed) {
+	htHandle *ht = obj->v.val, *pht = patch->v.val;
+	jsObject *val, *pval;
+	htEntry *he, *phe;
+	htIterator hi;
+
+	ht_init_iterator(pht,&hi);
+	while( (phe = ht_next(&hi)) ) {
+		pval = ht_get_val(phe);
+		he = ht_find_hash(ht,ht_get_key(phe),phe->hash);
+		val = he ? ht_get_val(he) : NULL;
+		if( JS_NULL == pval->type ) {
+			if( he ) {
+				ht_delete(ht,he);
+				changed[0] = JS_TRUE;
+			}
+			continue;
+		}
+		if( JS_OBJECT == pval->type ) {
+			if( val && JS_OBJECT == val->type ) {
+				if( !_js_merge_object(val,pval,changed) )
+					return JS_ERR;
+				continue;
+			}
+			_js_merge_strip(pval);
+		} else if( val && _js_equal(val,pval) )
+			continue;
+		if( !_js_merge_move(ht,he,pht,phe) )
+			return JS_ERR;
+		changed[0] = JS_TRUE;
+	}
+	return JS_OK;
+}
+
+// json dict
+static jsDict *_js_dict_new(void) {
+	jsDict *dict = calloc(1,sizeof(*dict));
+	if( !dict )
+		return NULL;
+	dict->pool = pl_create();
+	dict->slot = calloc(JS_DICT_SIZE_INIT,sizeof(*dict->slot));
+	if( !dict->pool || !dict->slot ) {
+		_js_dict_free(dict);
+		return NULL;
+	}
+	dict->size = JS_DICT_SIZE_INIT;
+	dict->type = htTypeJsonDict;
+	dict->pool_type = htTypeJsonDictPool;
+	return dict;
+}
+
+static void _js_dict_free(jsDict *dict) {
+	if( dict->pool )
+		pl_destroy(dict->pool);
+	JS_FREE(dict->slot);
+	JS_FREE(dict);
+}
+
+static int _js_dict_expand(jsDict *dict) {
+	unsigned int i, j, size = dict->size * 2;
+	jsKey **slot;
+
+	if( !size || !(slot = calloc(size,sizeof(*slot))) )
+		return JS_ERR;
+	for( i = 0; dict->size > i; i++ ) {
+		if( !dict->slot[i] )
+			continue;
+		for( j = dict->slot[i]->hash & (size - 1); slot[j]; j = (j + 1) & (size - 1) );
+		slot[j] = dict->slot[i];
+	}
+	JS_FREE(dict->slot);
+	dict->slot = slot;
+	dict->size = size;
+	return JS_OK;
+}
+
+static char *_js_dict_intern(jsDict *dict, const char *str, int len) {
+	unsigned int i, hash = ht_gen_hash_function(str,len);
+	jsKey *k;
+
+	if( dict->size <= dict->used * 2 && !_js_dict_expand(dict) )
+		return NULL;
+	for( i = hash & (dict->size - 1); (k = dict->slot[i]); i = (i + 1) & (dict->size - 1) )
+		if( hash == k->hash && len == k->len && 0 == memcmp(k->str,str,len) )
+			return k->str;
+	if( INT_MAX - (int)sizeof(*k) <= len || !(k = pl_alloc(dict->pool,sizeof(*k) + len + 1)) )
+		return NULL;
+	k->hash = hash;
+	k->len = len;
+	memcpy(k->str,str,len);
+	k->str[len] = '\0';
+	dict->slot[i] = k;
+	dict->used++;
+	return k->str;
+}
+
+// json lines
+static int _js_lines_blank(const char *p, long n) {
+	while( 0 < n && (' ' == p[n - 1] || '\t' == p[n - 1] || '\r' == p[n - 1]) )
+		n--;
+	return 0 == n;
+}
+
+/* Parses every record of c. A record cut by the end of the input has no
+ * newline behind it to stop the scalar parsers and is copied first. */
+static int _js_lines_chunk(jsLines *l, jsChunk *c) {
+	const char *p = c->buf, *end = c->buf + c->len, *q;
+	jsHandle *js;
+	long n;
+
+	c->n = 0;
+	for( ; end > p; p = q + 1 ) {
+		if( !(q = memchr(p,'\n',end - p)) )
+			q = end;
+		if( _js_lines_blank(p,n = q - p) )
+			continue;
+		if( c->n == c->size ) {
+			int size = c->size ? c->size * 2 : 64;
+			jsHandle *docs = realloc(c->docs,sizeof(*docs) * size);
+			if( !docs )
+				return JS_ERR;
+			c->docs = docs;
+			c->size = size;
+		}
+		js = c->docs + c->n++;
+		_js_init(js);
+		js->pool = c->pool;
+		js->dict = NULL;
+		js->own = 0;
+		if( INT_MAX < n ) {
+			js->err = (void *)p;
+			continue;
+		}
+		if( l->buf + l->len == q && !(p = pl_strdup(c->pool,p,n)) )
+			return JS_ERR;
+		_js_parse(js,p,n,0);
+	}
+	return JS_OK;
+}
+
+static void *_js_lines_worker(void *arg) {
+	jsLines *l = arg;
+	const char *p, *q;
+	jsChunk *c;
+	long left;
+	int r;
+
+	pthread_mutex_lock(&l->lock);
+	while( 1 ) {
+		while( !l->stop && l->len > l->off ) {
+			c = l->chunk + l->next % l->nchunk;
+			if( JS_CHUNK_FREE == c->state )
+				break;
+			pthread_cond_wait(&l->cond,&l->lock);
+		}
+		if( l->stop || l->len <= l->off )
+			break;
+		/* cut at the first newline past JS_LINES_CHUNK bytes */
+		p = l->buf + l->off;
+		left = l->len - l->off;
+		if( JS_LINES_CHUNK < left && (q = memchr(p + JS_LINES_CHUNK,'\n',left - JS_LINES_CHUNK)) )
+			q++;
+		else
+			q = p + left;
+		c->buf = p;
+		c->len = q - p;
+		c->state = JS_CHUNK_BUSY;
+		l->off += c->len;
+		l->next++;
+		pthread_mutex_unlock(&l->lock);
+
+		r = _js_lines_chunk(l,c);
+
+		pthread_mutex_lock(&l->lock);
+		c->state = r ? JS_CHUNK_DONE : JS_CHUNK_ERROR;
+		pthread_cond_broadcast(&l->cond);
+	}
+	pthread_mutex_unlock(&l->lock);
 	return NULL;
 }
 
+static int _js_lines_deliver(jsChunk *c, int (*cb)(void *ud, jsHandle *js), void *ud) {
+	int i;
+
+	if( JS_CHUNK_DONE != c->state )
+		return JS_ERR;
+	for( i = 0; c->n > i; i++ )
+		if( !cb(ud,c->docs + i) )
+			return JS_ERR;
+	return JS_OK;
+}
+
+/* Workers parse chunks ahead while the caller thread hands the docs to cb
+ * chunk by chunk, in input order. */
+static int _js_lines(const char *buf, long len, int threads, int (*cb)(void *ud, jsHandle *js), void *ud) {
+	pthread_t tid[JS_LINES_THREADS_MAX];
+	jsChunk *c;
+	jsLines l;
+	int i, seq, nthread = 0, r = JS_OK;
+
+	if( !buf || 0 > len )
+		return JS_ERR;
+	if( 0 >= threads )
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if( 0 >= threads )
+		threads = 1;
+	if( JS_LINES_THREADS_MAX < threads )
+		threads = JS_LINES_THREADS_MAX;
+
+	memset(&l,0,sizeof(l));
+	l.buf = buf;
+	l.len = len;
+	l.nchunk = threads * 2;
+	if( !(l.chunk = calloc(l.nchunk,sizeof(*l.chunk))) )
+		return JS_ERR;
+	for( i = 0; l.nchunk > i; i++ )
+		if( !(l.chunk[i].pool = pl_create()) )
+			r = JS_ERR;
+	pthread_mutex_init(&l.lock,NULL);
+	pthread_cond_init(&l.cond,NULL);
+	for( ; r && threads > nthread; nthread++ )
+		if( pthread_create(tid + nthread,NULL,_js_lines_worker,&l) )
+			break;
+	if( 0 == nthread )
+		r = JS_ERR;
+
+	for( seq = 0; r; seq++ ) {
+		c = l.chunk + seq % l.nchunk;
+		pthread_mutex_lock(&l.lock);
+		while( JS_CHUNK_DONE > c->state && (seq < l.next || l.len > l.off) )
+			pthread_cond_wait(&l.cond,&l.lock);
+		pthread_mutex_unlock(&l.lock);
+		if( JS_CHUNK_DONE > c->state )
+			break;
+		r = _js_lines_deliver(c,cb,ud);
+		pl_reset(c->pool);
+		pthread_mutex_lock(&l.lock);
+		c->state = JS_CHUNK_FREE;
+		pthread_cond_broadcast(&l.cond);
+		pthread_mutex_unlock(&l.lock);
+	}
+
+	pthread_mutex_lock(&l.lock);
+	l.stop = 1;
+	pthread_cond_broadcast(&l.cond);
+	pthread_mutex_unlock(&l.lock);
+	for( i = 0; nthread > i; i++ )
+		pthread_join(tid[i],NULL);
+	pthread_cond_destroy(&l.cond);
+	pthread_mutex_destroy(&l.lock);
+	for( i = 0; l.nchunk > i; i++ ) {
+		if( l.chunk[i].pool )
+			pl_destroy(l.chunk[i].pool);
+		JS_FREE(l.chunk[i].docs);
+	}
+	JS_FREE(l.chunk);
+	return r;
+}
+
+static int _js_lines_file(const char *path, int threads, int (*cb)(void *ud, jsHandle *js), void *ud) {
+	struct stat st;
+	void *buf;
+	int fd, r;
+
+	if( 0 > (fd = open(path,O_RDONLY)) )
+		return JS_ERR;
+	if( 0 > fstat(fd,&st) ) {
+		close(fd);
+		return JS_ERR;
+	}
+	if( 0 == st.st_size ) {
+		close(fd);
+		return JS_OK;
+	}
+	buf = mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd);
+	if( MAP_FAILED == buf )
+		return JS_ERR;
+	madvise(buf,st.st_size,MADV_SEQUENTIAL);
+	r = _js_lines(buf,st.st_size,threads,cb,ud);
+	munmap(buf,st.st_size);
+	return r;
+}
+
 // json functions
 static void _js_init(jsHandle *js) {
 	_js_reset(js);
@@ -800,63 +2305,142 @@ static void _js_init(jsHandle *js) {
 static void _js_reset(jsHandle *js) {
 	js->err = NULL;
 	js->obj = NULL;
+	js->feed = NULL;
 }
 
 static void _js_free(jsHandle *js) {
-	JS_OBJECT_FREE(js->obj);
+	if( js->feed )
+		_js_feed_free(js);
+	if( js->pool ) {
+		if( js->own )
+			pl_reset(js->pool);
+	} else
+		JS_OBJECT_FREE(js->obj);
 	_js_reset(js);
 }
 
-static int _js_parse(jsHandle *js, const char *str) {
-	jsObject *obj = _js_object_new();
-	if( obj ) {
-		const char *end = _js_parse_value(obj,_js_skip(str),(const char **)&js->err);
-		if( end && JS_OBJECT == obj->type ) {
-			js->obj = obj;
-			return JS_TRUE;
-		}
-		JS_OBJECT_FREE(obj);
+static int _js_parse(jsHandle *js, const char *str, int len, int insitu) {
+	jsFeed f;
+	int r = JS_ERR;
+
+	_js_feed_init(&f,js,NULL,NULL);
+	f.ps.insitu = insitu;
+	if( _js_feed_index(&f,(char *)str,len) ) {
+		if( JS_OBJECT == f.b.root->type ) {
+			js->obj = f.b.root;
+			f.b.root = NULL;
+			r = JS_TRUE;
+		} else
+			f.ps.err = str;
 	}
-	return JS_ERR;
+	_js_feed_release(&f);
+	JS_PARSER_FREE(&f.ps,f.b.root);
+	if( !r )
+		js->err = (void *)f.ps.err;
+	return r;
+}
+
+static int _js_sax_parse(jsHandle *js, const char *str, int len, jsSax *sax, void *ud) {
+	jsFeed f;
+	int r;
+
+	_js_feed_init(&f,js,sax,ud);
+	r = _js_feed_index(&f,(char *)str,len);
+	_js_feed_release(&f);
+	if( !r )
+		js->err = (void *)f.ps.err;
+	return r;
 }
 
 static int _js_replace(jsObject *obj, jsObject *rep) {
 	htEntry *rhe, *he;
-	htIterator *rhi;
+	htIterator hi;
 
-	if( !obj || !rep )
+	if( !_js_merge_domain(obj,rep) )
 		return JS_ERR;
 
-	rhi = ht_create_iterator(rep->v.val);
-	if( !rhi )
-		return JS_ERR;
-	while( (rhe = ht_next(rhi)) ) {
-		he = ht_find(obj->v.val,ht_get_key(rhe));
-		if( he )
-			ht_delete(obj->v.val,he);
-		ht_add(obj->v.val,ht_get_key(rhe),ht_get_val(rhe));
-		ht_get_key(rhe) = NULL;
-		ht_get_val(rhe) = NULL;
+	ht_init_iterator(rep->v.val,&hi);
+	while( (rhe = ht_next(&hi)) ) {
+		he = ht_find_hash(obj->v.val,ht_get_key(rhe),rhe->hash);
+		if( !_js_merge_move(obj->v.val,he,rep->v.val,rhe) )
+			return JS_ERR;
 	}
-	ht_destroy_iterator(rhi);
+	return JS_OK;
+}
+
+static int _js_merge(jsObject *obj, jsObject *patch, int *changed) {
+	int dummy;
+
+	if( !changed )
+		changed = &dummy;
+	changed[0] = JS_FALSE;
+	if( !_js_merge_domain(obj,patch) )
+		return JS_ERR;
+	return _js_merge_object(obj,patch,changed);
+}
+
+static int _js_foreach(jsObject *obj, int (*cb)(void *ud, const char *key, void *val), void *ud) {
+	htIterator hi;
+	htEntry *he;
+	jsArray *a;
+	int i;
+
+	if( !obj )
+		return JS_ERR;
+
+	if( JS_OBJECT == obj->type ) {
+		ht_init_iterator(obj->v.val,&hi);
+		while( (he = ht_next(&hi)) )
+			if( !cb(ud,ht_get_key(he),ht_get_val(he)) )
+				return JS_ERR;
+	} else if( JS_ARRAY == obj->type ) {
+		a = obj->v.val;
+		for( i = 0; a->len > i; i++ )
+			if( !cb(ud,NULL,a->item[i]) )
+				return JS_ERR;
+	} else
+		return JS_ERR;
 	return JS_OK;
 }
 
 static char *_js_print(jsObject *obj, int *len) {
-	char *buf;
+	jsBuffer *jbuf;
+	jsWriter w;
 
 	if( !obj )
 		return NULL;
 
-	buf = _js_buffer_new(JS_BUFFER_SIZE_INIT);
-	if( !buf )
+	memset(&w,0,sizeof(w));
+	if( !(w.buf = _js_buffer_new(JS_PRINT_SIZE_INIT)) )
 		return NULL;
-	if( !obj->print(obj,&buf) ) {
-		JS_BUFER_FREE(buf);
+	w.size = JS_PRINT_SIZE_INIT;
+	if( !_js_object_print(obj,&w) ) {
+		JS_BUFER_FREE(w.buf);
 		return NULL;
 	}
-	len[0] = _js_buffer_len(buf);
-	return buf;
+	jbuf = (jsBuffer *)(w.buf - sizeof(*jbuf));
+	jbuf->len = w.len;
+	jbuf->free = w.size - w.len;
+	w.buf[w.len] = '\0';
+	len[0] = w.len;
+	return w.buf;
+}
+
+static int _js_print_cb(jsObject *obj, int (*flush)(void *ud, const char *buf, int len), void *ud) {
+	char chunk[JS_PRINT_CHUNK];
+	jsWriter w;
+
+	if( !obj )
+		return JS_ERR;
+
+	w.buf = chunk;
+	w.len = 0;
+	w.size = sizeof(chunk);
+	w.flush = flush;
+	w.ud = ud;
+	if( !_js_object_print(obj,&w) )
+		return JS_ERR;
+	return _js_writer_flush(&w);
 }
 
 /* -------------------------------- api implementation ----------------------- */
@@ -866,11 +2450,34 @@ jsHandle *js_create(void) {
 	if( !js )
 		return NULL;
 	_js_init(js);
+	js->pool = NULL;
+	js->dict = NULL;
+	js->own = 0;
+	return js;
+}
+
+jsHandle *js_create_pool(void *pool) {
+	jsHandle *js = malloc(sizeof(*js));
+	if( !js )
+		return NULL;
+	_js_init(js);
+	js->pool = pool;
+	js->dict = NULL;
+	js->own = 0;
+	if( !js->pool ) {
+		if( !(js->pool = pl_create()) ) {
+			JS_FREE(js);
+			return NULL;
+		}
+		js->own = 1;
+	}
 	return js;
 }
 
 void js_destroy(jsHandle *js) {
 	_js_free(js);
+	if( js->own )
+		pl_destroy(js->pool);
 	JS_FREE(js);
 }
 
@@ -879,17 +2486,160 @@ void js_free(jsHandle *js) {
 }
 
 int js_parse(jsHandle *js, const char *str) {
-	return _js_parse(js,str);
+	return _js_parse(js,str,strlen(str),0);
+}
+
+int js_parse_insitu(jsHandle *js, char *str, int len) {
+	if( 0 > len || '\0' != str[len] )
+		return JS_ERR;
+	return _js_parse(js,str,len,1);
+}
+
+int js_sax_parse(jsHandle *js, const char *str, jsSax *sax, void *ud) {
+	return _js_sax_parse(js,str,strlen(str),sax,ud);
+}
+
+int js_feed(jsHandle *js, const char *chunk, int len) {
+	return _js_feed(js,chunk,len);
+}
+
+int js_finish(jsHandle *js) {
+	return _js_finish(js);
+}
+
+int js_parse_lines(const char *buf, long len, int threads, int (*cb)(void *ud, jsHandle *js), void *ud) {
+	return _js_lines(buf,len,threads,cb,ud);
+}
+
+int js_parse_lines_file(const char *path, int threads, int (*cb)(void *ud, jsHandle *js), void *ud) {
+	return _js_lines_file(path,threads,cb,ud);
 }
 
 int js_replace(void *obj, void *rep) {
 	return _js_replace(obj,rep);
 }
 
+int js_merge(void *obj, void *patch, int *changed) {
+	return _js_merge(obj,patch,changed);
+}
+
+int js_type(void *obj) {
+	return obj ? ((jsObject *)obj)->type : JS_INV;
+}
+
+int js_size(void *obj) {
+	jsObject *o = obj;
+	if( !o )
+		return 0;
+	switch( o->type ) {
+	case JS_OBJECT:
+		return ht_size((htHandle *)o->v.val);
+	case JS_ARRAY:
+		return ((jsArray *)o->v.val)->len;
+	case JS_STRING:
+		return o->len;
+	}
+	return 0;
+}
+
+void *js_get(void *obj, const char *key) {
+	jsObject *o = obj;
+	htEntry *he;
+	if( !o || JS_OBJECT != o->type )
+		return NULL;
+	/* tables of a dict can only hash their own keys */
+	if( !(he = ht_find_hash(o->v.val,key,_js_hash_function(key))) )
+		return NULL;
+	return ht_get_val(he);
+}
+
+void *js_at(void *obj, int index) {
+	jsObject *o = obj;
+	jsArray *a;
+	if( !o || JS_ARRAY != o->type || 0 > index )
+		return NULL;
+	a = o->v.val;
+	return a->len > index ? a->item[index] : NULL;
+}
+
+const char *js_string(void *obj, int *len) {
+	jsObject *o = obj;
+	if( !o || JS_STRING != o->type )
+		return NULL;
+	if( len )
+		len[0] = o->len;
+	return JS_OBJECT_STR(o);
+}
+
+long js_integer(void *obj) {
+	jsObject *o = obj;
+	if( !o || JS_NUMBER != o->type )
+		return 0;
+	if( !(o->flags & JS_FLAG_DOUBLE) )
+		return o->v.l64;
+	if( (double)LONG_MIN <= o->v.d64 && (double)LONG_MAX > o->v.d64 )
+		return (long)o->v.d64;
+	return 0;
+}
+
+double js_number(void *obj) {
+	jsObject *o = obj;
+	if( !o || JS_NUMBER != o->type )
+		return 0;
+	return o->flags & JS_FLAG_DOUBLE ? o->v.d64 : (double)o->v.l64;
+}
+
+int js_boolean(void *obj) {
+	jsObject *o = obj;
+	if( !o || JS_BOOLEAN != o->type )
+		return JS_FALSE;
+	return (int)o->v.l64;
+}
+
+int js_foreach(void *obj, int (*cb)(void *ud, const char *key, void *val), void *ud) {
+	return _js_foreach(obj,cb,ud);
+}
+
+jsPath *js_pointer_compile(const char *ptr) {
+	return _js_pointer_compile(ptr);
+}
+
+jsPath *js_path_compile(const char *path) {
+	return _js_path_compile(path);
+}
+
+void *js_path_get(jsPath *path, void *obj) {
+	return _js_path_get(path,obj);
+}
+
+void js_path_free(jsPath *path) {
+	JS_FREE(path);
+}
+
 char *js_print(void *obj, int *len) {
 	return _js_print(obj,len);
 }
 
+int js_print_cb(void *obj, int (*write)(void *ud, const char *buf, int len), void *ud) {
+	return _js_print_cb(obj,write,ud);
+}
+
+int js_print_fd(void *obj, int fd) {
+	return _js_print_cb(obj,_js_writer_fd,&fd);
+}
+
 void js_free_string(char *ptr) {
 	JS_BUFER_FREE(ptr);
 }
+
+jsDict *js_dict_create(void) {
+	return _js_dict_new();
+}
+
+void js_dict_destroy(jsDict *dict) {
+	_js_dict_free(dict);
+}
+
+void js_set_dict(jsHandle *js, jsDict *dict) {
+	js->dict = dict;
+}
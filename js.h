@@ -15,8 +15,35 @@ extern "C" {
 typedef struct jsHandle {
 	void *err;
 	void *obj;
+	void *pool;
+	void *feed;
+	void *dict;
+	int own;
 } jsHandle;
 
+/* Parser events. A callback returns JS_OK to go on or JS_ERR to stop the
+ * parse, and may be NULL. Strings and keys are decoded but are not
+ * NUL-terminated and only valid during the call. */
+typedef struct jsSax {
+	int (*start_object)(void *ud);
+	int (*end_object)(void *ud);
+	int (*start_array)(void *ud);
+	int (*end_array)(void *ud);
+	int (*key)(void *ud, const char *str, int len);
+	int (*string)(void *ud, const char *str, int len);
+	int (*integer)(void *ud, long value);
+	int (*number)(void *ud, double value);
+	int (*boolean)(void *ud, int value);
+	int (*null)(void *ud);
+} jsSax;
+
+/* A path compiled once by js_pointer_compile or js_path_compile and then
+ * looked up in any number of documents. */
+typedef struct jsPath jsPath;
+
+/* Object keys interned once for many documents, see js_set_dict. */
+typedef struct jsDict jsDict;
+
 /* -------------------------------- define ----------------------------------- */
 
 #define JS_OK 1
@@ -38,15 +65,64 @@ typedef struct jsHandle {
 /* -------------------------------- api -------------------------------------- */
 
 jsHandle *js_create(void);
+jsHandle *js_create_pool(void *pool);
 void js_destroy(jsHandle *js);
 void js_free(jsHandle *js);
 int js_parse(jsHandle *js, const char *str);
+int js_parse_insitu(jsHandle *js, char *str, int len);
+int js_sax_parse(jsHandle *js, const char *str, jsSax *sax, void *ud);
+int js_feed(jsHandle *js, const char *chunk, int len);
+int js_finish(jsHandle *js);
+
+/* Parses newline-delimited documents on threads workers, all cores when
+ * threads is 0, and calls cb for each non-blank line in input order on
+ * the calling thread. A line that failed to parse has a NULL object and
+ * its error set. The doc is only valid during the call; cb returns JS_ERR
+ * to stop. The _file variant maps the file at path. */
+int js_parse_lines(const char *buf, long len, int threads, int (*cb)(void *ud, jsHandle *js), void *ud);
+int js_parse_lines_file(const char *path, int threads, int (*cb)(void *ud, jsHandle *js), void *ud);
 
 int js_replace(void *obj, void *rep);
 
+/* Applies the RFC 7396 merge patch patch to obj in place; changed tells
+ * whether obj is different afterwards. Both must be objects of documents
+ * allocated the same way. Members of patch move into obj, so patch only
+ * keeps what was not needed and must still be freed; an in situ patch
+ * must keep its input alive as long as obj. */
+int js_merge(void *obj, void *patch, int *changed);
+
+/* Accessors take any value of a document and return JS_INV, NULL or 0
+ * for a missing value or one of another type. js_foreach passes a NULL
+ * key for array elements and stops when cb returns JS_ERR. */
+int js_type(void *obj);
+int js_size(void *obj);
+void *js_get(void *obj, const char *key);
+void *js_at(void *obj, int index);
+const char *js_string(void *obj, int *len);
+long js_integer(void *obj);
+double js_number(void *obj);
+int js_boolean(void *obj);
+int js_foreach(void *obj, int (*cb)(void *ud, const char *key, void *val), void *ud);
+
+/* RFC 6901 pointers such as /a/b/2 or ~0 and ~1 escaped, and dotted paths
+ * such as a.b[2].c with '\' escaping a byte of a name. */
+jsPath *js_pointer_compile(const char *ptr);
+jsPath *js_path_compile(const char *path);
+void *js_path_get(jsPath *path, void *obj);
+void js_path_free(jsPath *path);
+
 char *js_print(void *obj, int *len);
+int js_print_cb(void *obj, int (*write)(void *ud, const char *buf, int len), void *ud);
+int js_print_fd(void *obj, int fd);
 void js_free_string(char *ptr);
 
+/* Documents parsed after js_set_dict store their keys in dict, which
+ * must outlive them. A dict grows with every distinct key and is not
+ * safe to use from several threads at once. */
+jsDict *js_dict_create(void);
+void js_dict_destroy(jsDict *dict);
+void js_set_dict(jsHandle *js, jsDict *dict);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,33 @@
+/* Number Conversion Implementation.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ */
+
+#ifndef __NM_H_
+#define __NM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -------------------------------- define ----------------------------------- */
+
+#define NM_LONG_SIZE 24
+#define NM_DOUBLE_SIZE 32
+
+#define NM_LONG 1
+#define NM_DOUBLE 2
+
+/* -------------------------------- api functions ---------------------------- */
+
+int nm_ltoa(long value, char *buf);
+int nm_ultoa(unsigned long value, char *buf);
+int nm_dtoa(double value, char *buf);
+int nm_strtonum(const char *str, const char **end, long *l, double *d);
+double nm_strtod(const char *str, const char **end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NM_H_ */
@@ -3,10 +3,28 @@
  * This library is free software; you can redistribute it and/or modify
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PB_AVX2
+#endif
+
+#include "nm.h"
 
 #include "pb.h"
 
@@ -15,6 +33,8 @@
 typedef struct pbHandle {
 	int len;
 	int free;
+	int off;
+	int ref;
 	char buf[];
 } pbHandle;
 
@@ -24,40 +44,264 @@ typedef struct pbHandle {
 	do { if(_p) { free(_p); _p = NULL; } } while(0)
 
 #define PB_MAX(_a,_b) \
-	(_a) > (_b) ? (_a) : (_b)
+	((_a) > (_b) ? (_a) : (_b))
+
+#define PB_GROW_LIMIT (1024 * 1024)
+#define PB_GROW_CHUNK (1024 * 1024)
+#define PB_SIZE_MAX (INT_MAX - (int)sizeof(pbHandle) - 1)
+#define PB_RING_MAX (1U << 30)
+#define PB_ROPE_CHUNK (64 * 1024)
+#define PB_SPRINTF_STACK 256
+#define PB_FIND_AVX2_MAX 3
+#define PB_FIND_NEEDLE_MAX 255
 
 /* -------------------------------- static ----------------------------------- */
 
 static void _pb_cat(char *p, const char *buf, int len);
 static void _pb_cpy(char *p, const char *buf, int len);
+static void _pb_compact(pbHandle *pb);
+static char *_pb_detach(char *p, int size);
+static int _pb_range(int len, int *begin, int *end);
+static int _pb_find_cspn(const char *s, int len, const char *set);
+static int _pb_find_set(const char *s, int len, const char *set);
+static int _pb_casecmp(const char *s1, const char *s2, int len);
 static char *_pb_vsprintf(char *p, const char *fmt, va_list va);
+static char *_pb_ring_map(int fd, unsigned int size);
+static int _pb_rope_push(pbRope *r, char *p);
+static int _pb_rope_find(pbRope *r, long off);
 
 /* -------------------------------- static implementation -------------------- */
 
 static void _pb_cat(char *p, const char *buf, int len) {
 	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
-	memcpy(pb->buf + pb->len,buf,len);
+	memcpy(pb->buf + pb->off + pb->len,buf,len);
 	pb->free -= len;
 	pb->len += len;
-	pb->buf[pb->len] = '\0';
+	pb->buf[pb->off + pb->len] = '\0';
 }
 
 static void _pb_cpy(char *p, const char *buf, int len) {
 	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
 	memcpy(pb->buf,buf,len);
-	pb->free = pb->free + pb->len - len;
+	pb->free = pb->free + pb->off + pb->len - len;
+	pb->off = 0;
 	pb->len = len;
 	pb->buf[pb->len] = '\0';
 }
 
+static void _pb_compact(pbHandle *pb) {
+	if( !pb->off )
+		return;
+	memmove(pb->buf,pb->buf + pb->off,pb->len + 1);
+	pb->free += pb->off;
+	pb->off = 0;
+}
+
+/* ref counts the holders beyond the first one, so a fresh buffer is 0.
+ * A shared buffer is copied before it is modified and the copy is owned
+ * by the caller alone. The copy has at least size bytes free, so the
+ * change that follows cannot fail once the original has been let go. */
+static char *_pb_detach(char *p, int size) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	char *t;
+	if( 0 == __atomic_load_n(&pb->ref,__ATOMIC_ACQUIRE) )
+		return p;
+	if( PB_SIZE_MAX - pb->len < size )
+		return NULL;
+	t = pb_new(pb->len + PB_MAX(pb->free,size));
+	if( !t )
+		return NULL;
+	_pb_cat(t,pb->buf + pb->off,pb->len);
+	pb_unref(p);
+	return t;
+}
+
+/* s must be terminated at len, which every pb is; NULs inside the data
+ * stop strcspn early and are stepped over. */
+static int _pb_find_cspn(const char *s, int len, const char *set) {
+	int i;
+	for( i = 0; ; ++i ) {
+		i += strcspn(s + i,set);
+		if( len <= i )
+			return -1;
+		if( '\0' != s[i] )
+			return i;
+	}
+}
+
+#if defined(PB_AVX2)
+__attribute__((target("avx2")))
+static int _pb_find_set_avx2(const char *s, int len, const char *set, int setlen) {
+	__m256i x, m, v[PB_FIND_AVX2_MAX];
+	int i, k, r;
+	unsigned int mask;
+
+	for( k = 0; setlen > k; ++k )
+		v[k] = _mm256_set1_epi8(set[k]);
+	for( i = 0; len - 32 >= i; i += 32 ) {
+		x = _mm256_loadu_si256((const __m256i *)(s + i));
+		m = _mm256_cmpeq_epi8(x,v[0]);
+		for( k = 1; setlen > k; ++k )
+			m = _mm256_or_si256(m,_mm256_cmpeq_epi8(x,v[k]));
+		if( (mask = _mm256_movemask_epi8(m)) )
+			return i + __builtin_ctz(mask);
+	}
+	r = _pb_find_cspn(s + i,len - i,set);
+	return 0 > r ? r : i + r;
+}
+#endif
+
+/* The set is a C string, as for strpbrk. A single byte goes to memchr and
+ * larger sets to strcspn, both vectorized by libc. Only sets of two or
+ * three bytes, e.g. "\r\n", are scanned faster by comparing 32 bytes at
+ * a time with AVX2 (see bench/pb_find.c). */
+static int _pb_find_set(const char *s, int len, const char *set) {
+	const char *r;
+
+	if( 0 >= len || '\0' == set[0] )
+		return -1;
+	if( '\0' == set[1] ) {
+		r = memchr(s,set[0],len);
+		return r ? r - s : -1;
+	}
+#if defined(PB_AVX2)
+	if( ('\0' == set[2] || '\0' == set[3]) && __builtin_cpu_supports("avx2") )
+		return _pb_find_set_avx2(s,len,set,'\0' == set[2] ? 2 : 3);
+#endif
+	return _pb_find_cspn(s,len,set);
+}
+
+static int _pb_casecmp(const char *s1, const char *s2, int len) {
+	int i = 0, c1, c2;
+#if defined(__SSE2__)
+	const __m128i a = _mm_set1_epi8('A' - 1), z = _mm_set1_epi8('Z' + 1);
+	const __m128i bit = _mm_set1_epi8(0x20);
+	__m128i x, y;
+	for( ; len - 16 >= i; i += 16 ) {
+		x = _mm_loadu_si128((const __m128i *)(s1 + i));
+		y = _mm_loadu_si128((const __m128i *)(s2 + i));
+		x = _mm_or_si128(x,_mm_and_si128(bit,_mm_and_si128(_mm_cmpgt_epi8(x,a),_mm_cmplt_epi8(x,z))));
+		y = _mm_or_si128(y,_mm_and_si128(bit,_mm_and_si128(_mm_cmpgt_epi8(y,a),_mm_cmplt_epi8(y,z))));
+		if( 0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(x,y)) )
+			break;
+	}
+#endif
+	for( ; len > i; ++i ) {
+		c1 = (unsigned char)s1[i];
+		c2 = (unsigned char)s2[i];
+		if( 'A' <= c1 && 'Z' >= c1 )
+			c1 |= 0x20;
+		if( 'A' <= c2 && 'Z' >= c2 )
+			c2 |= 0x20;
+		if( c1 != c2 )
+			return c1 - c2;
+	}
+	return 0;
+}
+
+static int _pb_range(int len, int *begin, int *end) {
+	int new_len;
+	if( 0 > begin[0] ) {
+		begin[0] += len;
+		if( 0 > begin[0] )
+			begin[0] = 0;
+	}
+	if( 0 > end[0] ) {
+		end[0] += len;
+		if( 0 > end[0] )
+			end[0] = 0;
+	}
+	new_len = (begin[0] > end[0]) ? 0 : (end[0] - begin[0]) + 1;
+	if( 0 != new_len ) {
+		if( begin[0] >= len ) {
+			new_len = 0;
+		} else if( end[0] >= len ) {
+			end[0] = len - 1;
+			new_len = (begin[0] > end[0]) ? 0 : (end[0] - begin[0]) + 1;
+		}
+	}
+	if( 0 == new_len )
+		begin[0] = 0;
+	return new_len;
+}
+
+/* The arguments may point into p itself, e.g. pb_sprintf(p,"%s",p), so
+ * the output is formatted aside and appended only once the room is there.
+ * Short output stays on the stack, longer output is measured first. */
 static char *_pb_vsprintf(char *p, const char *fmt, va_list va) {
-	char *out, *t;
+	char tmp[PB_SPRINTF_STACK], *buf = tmp;
+	va_list cp;
 	int len;
-	if( -1 == (len = vasprintf(&t,fmt,va)) )
+
+	va_copy(cp,va);
+	len = vsnprintf(tmp,sizeof(tmp),fmt,cp);
+	va_end(cp);
+	if( 0 > len )
 		return NULL;
-	out = pb_cat(p,t,len);
-	PB_FREE(t);
-	return out;
+	if( (int)sizeof(tmp) <= len ) {
+		if( !(buf = malloc((size_t)len + 1)) )
+			return NULL;
+		vsnprintf(buf,len + 1,fmt,va);
+	}
+	if( (p = pb_renew(p,len)) )
+		_pb_cat(p,buf,len);
+	if( tmp != buf )
+		PB_FREE(buf);
+	return p;
+}
+
+/* The ring is mapped twice back to back, so the bytes past the end of the
+ * first view are the start of the buffer again and any window of up to
+ * size bytes is contiguous. */
+static char *_pb_ring_map(int fd, unsigned int size) {
+	char *base, *p;
+
+	base = mmap(NULL,(size_t)size * 2,PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+	if( MAP_FAILED == base )
+		return NULL;
+	p = mmap(base,size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0);
+	if( MAP_FAILED == p )
+		goto err;
+	p = mmap(base + size,size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_FIXED,fd,0);
+	if( MAP_FAILED == p )
+		goto err;
+	return base;
+
+err:
+	munmap(base,(size_t)size * 2);
+	return NULL;
+}
+
+static int _pb_rope_push(pbRope *r, char *p) {
+	pbRopeSeg *segs;
+	int cap;
+
+	if( r->cnt == r->cap ) {
+		cap = r->cap ? r->cap * 2 : 8;
+		if( !(segs = realloc(r->segs,cap * sizeof(*segs))) )
+			return PB_ERR;
+		r->segs = segs;
+		r->cap = cap;
+	}
+	r->segs[r->cnt].buf = p;
+	r->segs[r->cnt].off = r->len;
+	r->cnt++;
+	r->len += pb_len(p);
+	return PB_OK;
+}
+
+/* Index of the segment holding byte off, by binary search over the
+ * cumulative start offsets. */
+static int _pb_rope_find(pbRope *r, long off) {
+	int lo = 0, hi = r->cnt - 1, mid;
+	while( lo < hi ) {
+		mid = (lo + hi + 1) / 2;
+		if( r->segs[mid].off <= off )
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
 }
 
 /* -------------------------------- api implementation ----------------------- */
@@ -81,11 +325,24 @@ char *pb_new_len(char *p, int size) {
 }
 
 char *pb_renew(char *p, int size) {
-	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	pbHandle *pb;
+	if( !(p = _pb_detach(p,size)) )
+		return NULL;
+	pb = (pbHandle *)(p - sizeof(*pb));
+	if( pb->free < size )
+		_pb_compact(pb);
 	if( pb->free < size ) {
-		int buf_size = pb->free + pb->len;
-		int add_size = pb->len + size;
-		int new_size = PB_MAX(buf_size * 2,add_size + 8);
+		long buf_size = pb->free + pb->len;
+		long add_size = (long)pb->len + size;
+		long new_size;
+		if( PB_GROW_LIMIT > add_size )
+			new_size = PB_MAX(buf_size * 2,add_size + 8);
+		else
+			new_size = add_size + PB_GROW_CHUNK;
+		if( PB_SIZE_MAX < new_size )
+			new_size = PB_SIZE_MAX;
+		if( new_size < add_size )
+			return NULL;
 		pb = realloc(pb,sizeof(*pb) + new_size + 1);
 		if( !pb )
 			return NULL;
@@ -95,8 +352,24 @@ char *pb_renew(char *p, int size) {
 }
 
 void pb_free(char *p) {
+	pb_unref(p);
+}
+
+char *pb_ref(char *p) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	__atomic_add_fetch(&pb->ref,1,__ATOMIC_RELAXED);
+	return p;
+}
+
+void pb_unref(char *p) {
 	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
-	PB_FREE(pb);
+	if( 0 == __atomic_fetch_sub(&pb->ref,1,__ATOMIC_ACQ_REL) )
+		PB_FREE(pb);
+}
+
+int pb_shared(char *p) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	return 0 < __atomic_load_n(&pb->ref,__ATOMIC_ACQUIRE);
 }
 
 int pb_size(char *p) {
@@ -109,19 +382,34 @@ int pb_len(char *p) {
 	return pb->len;
 }
 
-void pb_set_len(char *p, int len) {
-	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
-	int size = pb->free + pb->len;
+char *pb_set_len(char *p, int len) {
+	pbHandle *pb;
+	int size;
+	if( !(p = _pb_detach(p,0)) )
+		return NULL;
+	pb = (pbHandle *)(p - sizeof(*pb));
+	size = pb->free + pb->len;
 	pb->free = size - len;
 	pb->len = len;
-	pb->buf[pb->len] = '\0';
+	pb->buf[pb->off + pb->len] = '\0';
+	return p;
 }
 
 void pb_incr_len(char *p, int len) {
 	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
 	pb->free -= len;
 	pb->len += len;
-	pb->buf[pb->len] = '\0';
+	pb->buf[pb->off + pb->len] = '\0';
+}
+
+char *pb_data(char *p) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	return pb->buf + pb->off;
+}
+
+char *pb_tail(char *p) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	return pb->buf + pb->off + pb->len;
 }
 
 char *pb_cat(char *p, const char *buf, int len) {
@@ -137,56 +425,150 @@ char *pb_cat(char *p, const char *buf, int len) {
 int pb_cmp(char *p, const char *buf, int len) {
 	if( 0 == len )
 		return 0;
-	return memcmp(p,buf,len);
+	return memcmp(pb_data(p),buf,len);
+}
+
+int pb_casecmp(char *p, const char *buf, int len) {
+	if( 0 == len )
+		return 0;
+	return _pb_casecmp(pb_data(p),buf,len);
+}
+
+int pb_find_byte(char *p, int from, char c) {
+	const char *s, *r;
+	if( 0 > from || pb_len(p) <= from )
+		return -1;
+	s = pb_data(p);
+	r = memchr(s + from,c,pb_len(p) - from);
+	return r ? r - s : -1;
+}
+
+int pb_find_any(char *p, int from, const char *set) {
+	int r;
+	if( 0 > from || pb_len(p) <= from )
+		return -1;
+	r = _pb_find_set(pb_data(p) + from,pb_len(p) - from,set);
+	return 0 > r ? r : from + r;
+}
+
+/* strstr is several times faster than memmem on glibc, so a needle
+ * without NULs is searched with it segment by segment between the NULs
+ * of the data; the terminator of the pb ends the last one. */
+int pb_find(char *p, int from, const char *buf, int len) {
+	char needle[PB_FIND_NEEDLE_MAX + 1];
+	const char *s, *r;
+	int i;
+
+	if( 0 > from || pb_len(p) < from + len )
+		return -1;
+	s = pb_data(p);
+	if( 0 == len || PB_FIND_NEEDLE_MAX < len || memchr(buf,'\0',len) ) {
+		r = memmem(s + from,pb_len(p) - from,buf,len);
+		return r ? r - s : -1;
+	}
+	memcpy(needle,buf,len);
+	needle[len] = '\0';
+	for( i = from; pb_len(p) - len >= i; i += strlen(s + i) + 1 )
+		if( (r = strstr(s + i,needle)) )
+			return r - s;
+	return -1;
+}
+
+void pb_split_init(pbSplit *it, char *p, const char *set) {
+	it->ptr = pb_data(p);
+	it->end = it->ptr + pb_len(p);
+	it->set = set;
+}
+
+int pb_split_next(pbSplit *it, pbSlice *s) {
+	int r;
+	if( !it->ptr )
+		return PB_ERR;
+	s->ptr = it->ptr;
+	r = _pb_find_set(it->ptr,it->end - it->ptr,it->set);
+	if( 0 > r ) {
+		s->len = it->end - it->ptr;
+		it->ptr = NULL;
+	} else {
+		s->len = r;
+		it->ptr += r + 1;
+	}
+	return PB_OK;
 }
 
 char *pb_cpy(char *p, const char *buf, int len) {
-	int diff, size;
+	int diff, size = 0;
 	if( 0 == len )
 		return p;
+	/* pb_renew detaches and grows before anything is overwritten */
 	diff = pb_size(p) - len;
-	if( 0 > diff ) {
+	if( 0 > diff )
 		size = pb_size(p) - pb_len(p) - diff;
-		p = pb_renew(p,size);
-	}
-	if( p ) {
-		_pb_cpy(p,buf,len);
-	}
+	if( !(p = pb_renew(p,size)) )
+		return NULL;
+	_pb_cpy(p,buf,len);
 	return p;
 }
 
 char *pb_sub(char *p, int begin, int end) {
-	return NULL;
+	pbSlice s = pb_slice(p,begin,end);
+	return pb_new_len((char *)s.ptr,s.len);
+}
+
+pbSlice pb_slice(char *p, int begin, int end) {
+	pbSlice s;
+	s.len = _pb_range(pb_len(p),&begin,&end);
+	s.ptr = pb_data(p) + begin;
+	return s;
 }
 
-void pb_mov(char *p, int begin, int end) {
+char *pb_slice_dup(pbSlice s) {
+	return pb_new_len((char *)s.ptr,s.len);
+}
+
+char *pb_mov(char *p, int begin, int end) {
+	pbHandle *pb;
 	int new_len, len = pb_len(p);
 	if( 0 == len )
-		return;
-	if( 0 > begin ) {
-		begin += len;
-		if( 0 > begin )
-			begin = 0;
-	}
-	if( 0 > end ) {
-		end += len;
-		if( 0 > end )
-			end = 0;
+		return p;
+	if( !(p = _pb_detach(p,0)) )
+		return NULL;
+	pb = (pbHandle *)(p - sizeof(*pb));
+	new_len = _pb_range(len,&begin,&end);
+	if( new_len )
+		memmove(pb->buf,pb->buf + pb->off + begin,new_len);
+	pb->free += pb->off;
+	pb->off = 0;
+	return pb_set_len(p,new_len);
+}
+
+char *pb_consume(char *p, int len) {
+	pbHandle *pb = (pbHandle *)(p - sizeof(*pb));
+	char *t;
+	if( 0 >= len )
+		return p;
+	/* a shared buffer keeps its bytes, the caller gets only what is left */
+	if( 0 < __atomic_load_n(&pb->ref,__ATOMIC_ACQUIRE) ) {
+		if( pb->len <= len )
+			t = pb_new(0);
+		else
+			t = pb_new_len(pb->buf + pb->off + len,pb->len - len);
+		if( t )
+			pb_unref(p);
+		return t;
 	}
-	new_len = (begin > end) ? 0 : (end - begin) + 1;
-	if( 0 != new_len ) {
-		if( begin >= len ) {
-			new_len = 0;
-		} else if( end >= len ) {
-			end = len - 1;
-			new_len = (begin > end) ? 0 : (end - begin) + 1;
-		}
-	} else {
-		begin = 0;
+	if( pb->len <= len ) {
+		pb->free += pb->off + pb->len;
+		pb->off = 0;
+		pb->len = 0;
+		pb->buf[0] = '\0';
+		return p;
 	}
-	if( begin && new_len )
-		memmove(p,p+begin,new_len);
-	pb_set_len(p,new_len);
+	pb->off += len;
+	pb->len -= len;
+	if( pb->off > pb->len + pb->free )
+		_pb_compact(pb);
+	return p;
 }
 
 char *pb_sprintf(char *p, const char *fmt, ...) {
@@ -200,3 +582,350 @@ char *pb_sprintf(char *p, const char *fmt, ...) {
 	va_end(va);
 	return out;
 }
+
+char *pb_cat_char(char *p, char c) {
+	pbHandle *pb;
+	if( !(p = pb_renew(p,1)) )
+		return NULL;
+	pb = (pbHandle *)(p - sizeof(*pb));
+	pb->buf[pb->off + pb->len] = c;
+	pb->free--;
+	pb->len++;
+	pb->buf[pb->off + pb->len] = '\0';
+	return p;
+}
+
+char *pb_cat_long(char *p, long value) {
+	if( !(p = pb_renew(p,NM_LONG_SIZE)) )
+		return NULL;
+	pb_incr_len(p,nm_ltoa(value,pb_tail(p)));
+	return p;
+}
+
+char *pb_cat_ulong(char *p, unsigned long value) {
+	if( !(p = pb_renew(p,NM_LONG_SIZE)) )
+		return NULL;
+	pb_incr_len(p,nm_ultoa(value,pb_tail(p)));
+	return p;
+}
+
+char *pb_cat_double(char *p, double value) {
+	if( !(p = pb_renew(p,NM_DOUBLE_SIZE)) )
+		return NULL;
+	pb_incr_len(p,nm_dtoa(value,pb_tail(p)));
+	return p;
+}
+
+int pb_read_fd(char **p, int fd, int max) {
+	char *t;
+	int n;
+	if( !(t = pb_renew(p[0],max)) )
+		return -1;
+	p[0] = t;
+	n = read(fd,pb_tail(t),max);
+	if( 0 < n )
+		pb_incr_len(t,n);
+	return n;
+}
+
+int pb_write_fd(char *p, int fd, int *off) {
+	int n;
+	if( 0 > *off || pb_len(p) <= *off )
+		return 0;
+	n = write(fd,pb_data(p) + *off,pb_len(p) - *off);
+	if( 0 < n )
+		*off += n;
+	return n;
+}
+
+int pb_slice_write_fd(pbSlice *s, int fd) {
+	int n;
+	if( 0 == s->len )
+		return 0;
+	n = write(fd,s->ptr,s->len);
+	if( 0 < n ) {
+		s->ptr += n;
+		s->len -= n;
+	}
+	return n;
+}
+
+void pb_chain_init(pbChain *c) {
+	c->cnt = 0;
+}
+
+int pb_chain_add(pbChain *c, char *p) {
+	if( PB_CHAIN_MAX <= c->cnt )
+		return PB_ERR;
+	c->bufs[c->cnt++] = p;
+	return PB_OK;
+}
+
+int pb_chain_read_fd(pbChain *c, int fd) {
+	struct iovec iov[PB_CHAIN_MAX];
+	int i, n, len, cnt = 0;
+
+	for( i = 0; c->cnt > i; ++i ) {
+		if( !(c->bufs[i] = _pb_detach(c->bufs[i],0)) )
+			return -1;
+		len = pb_size(c->bufs[i]) - pb_len(c->bufs[i]);
+		if( 0 == len )
+			continue;
+		iov[cnt].iov_base = pb_tail(c->bufs[i]);
+		iov[cnt].iov_len = len;
+		cnt++;
+	}
+	if( 0 == cnt )
+		return 0;
+
+	n = readv(fd,iov,cnt);
+	for( len = n, i = 0; 0 < len && c->cnt > i; ++i ) {
+		int free = pb_size(c->bufs[i]) - pb_len(c->bufs[i]);
+		if( free > len )
+			free = len;
+		pb_incr_len(c->bufs[i],free);
+		len -= free;
+	}
+	return n;
+}
+
+int pb_chain_write_fd(pbChain *c, int fd, long *off) {
+	struct iovec iov[PB_CHAIN_MAX];
+	int i, n, len, cnt = 0;
+	long skip = *off;
+
+	for( i = 0; c->cnt > i; ++i ) {
+		len = pb_len(c->bufs[i]);
+		if( skip >= len ) {
+			skip -= len;
+			continue;
+		}
+		iov[cnt].iov_base = pb_data(c->bufs[i]) + skip;
+		iov[cnt].iov_len = len - skip;
+		skip = 0;
+		cnt++;
+	}
+	if( 0 == cnt )
+		return 0;
+
+	n = writev(fd,iov,cnt);
+	if( 0 < n )
+		*off += n;
+	return n;
+}
+
+pbRing *pb_ring_create(int size) {
+	unsigned int cap = (unsigned int)sysconf(_SC_PAGESIZE);
+	pbRing *r;
+
+	if( 0 > size || PB_RING_MAX < (unsigned int)size )
+		return NULL;
+	while( cap < (unsigned int)size )
+		cap <<= 1;
+	if( !(r = malloc(sizeof(*r))) )
+		return NULL;
+
+	r->fd = memfd_create("pb_ring",MFD_CLOEXEC);
+	if( 0 > r->fd )
+		goto err;
+	if( 0 > ftruncate(r->fd,cap) )
+		goto err;
+	if( !(r->buf = _pb_ring_map(r->fd,cap)) )
+		goto err;
+	r->size = cap;
+	r->head = r->tail = 0;
+	return r;
+
+err:
+	if( 0 <= r->fd )
+		close(r->fd);
+	PB_FREE(r);
+	return NULL;
+}
+
+void pb_ring_destroy(pbRing *r) {
+	if( !r )
+		return;
+	munmap(r->buf,(size_t)r->size * 2);
+	close(r->fd);
+	free(r);
+}
+
+int pb_ring_len(pbRing *r) {
+	return r->tail - r->head;
+}
+
+int pb_ring_free(pbRing *r) {
+	return r->size - (r->tail - r->head);
+}
+
+char *pb_ring_reserve(pbRing *r, int *len) {
+	*len = pb_ring_free(r);
+	return r->buf + (r->tail & (r->size - 1));
+}
+
+int pb_ring_commit(pbRing *r, int len) {
+	if( 0 > len || pb_ring_free(r) < len )
+		return PB_ERR;
+	r->tail += len;
+	return PB_OK;
+}
+
+char *pb_ring_peek(pbRing *r, int *len) {
+	*len = pb_ring_len(r);
+	return r->buf + (r->head & (r->size - 1));
+}
+
+int pb_ring_consume(pbRing *r, int len) {
+	if( 0 > len || pb_ring_len(r) < len )
+		return PB_ERR;
+	r->head += len;
+	if( r->head == r->tail )
+		r->head = r->tail = 0;
+	return PB_OK;
+}
+
+int pb_ring_read_fd(pbRing *r, int fd) {
+	int n, len;
+	char *p = pb_ring_reserve(r,&len);
+	if( 0 == len )
+		return 0;
+	n = read(fd,p,len);
+	if( 0 < n )
+		r->tail += n;
+	return n;
+}
+
+int pb_ring_write_fd(pbRing *r, int fd) {
+	int n, len;
+	char *p = pb_ring_peek(r,&len);
+	if( 0 == len )
+		return 0;
+	n = write(fd,p,len);
+	if( 0 < n )
+		pb_ring_consume(r,n);
+	return n;
+}
+
+void pb_rope_init(pbRope *r) {
+	r->segs = NULL;
+	r->cnt = 0;
+	r->cap = 0;
+	r->len = 0;
+}
+
+void pb_rope_free(pbRope *r) {
+	int i;
+	for( i = 0; r->cnt > i; ++i )
+		pb_unref(r->segs[i].buf);
+	PB_FREE(r->segs);
+	pb_rope_init(r);
+}
+
+long pb_rope_len(pbRope *r) {
+	return r->len;
+}
+
+int pb_rope_cat(pbRope *r, const char *buf, int len) {
+	char *last;
+	int n;
+
+	while( 0 < len ) {
+		last = r->cnt ? r->segs[r->cnt - 1].buf : NULL;
+		if( !last || pb_shared(last) || pb_size(last) == pb_len(last) ) {
+			if( !(last = pb_new(PB_ROPE_CHUNK)) )
+				return PB_ERR;
+			if( !_pb_rope_push(r,last) ) {
+				pb_free(last);
+				return PB_ERR;
+			}
+		}
+		n = pb_size(last) - pb_len(last);
+		if( n > len )
+			n = len;
+		memcpy(pb_tail(last),buf,n);
+		pb_incr_len(last,n);
+		r->len += n;
+		buf += n;
+		len -= n;
+	}
+	return PB_OK;
+}
+
+int pb_rope_add(pbRope *r, char *p) {
+	if( 0 == pb_len(p) )
+		return PB_OK;
+	if( !_pb_rope_push(r,p) )
+		return PB_ERR;
+	pb_ref(p);
+	return PB_OK;
+}
+
+int pb_rope_join(pbRope *r, pbRope *other) {
+	int i;
+	if( r == other )
+		return PB_ERR;
+	for( i = 0; other->cnt > i; ++i )
+		if( !_pb_rope_push(r,other->segs[i].buf) )
+			break;
+	if( other->cnt > i ) {
+		while( i-- )
+			r->len -= pb_len(r->segs[--r->cnt].buf);
+		return PB_ERR;
+	}
+	PB_FREE(other->segs);
+	pb_rope_init(other);
+	return PB_OK;
+}
+
+int pb_rope_at(pbRope *r, long off) {
+	pbRopeSeg *s;
+	if( 0 > off || r->len <= off )
+		return -1;
+	s = &r->segs[_pb_rope_find(r,off)];
+	return (unsigned char)pb_data(s->buf)[off - s->off];
+}
+
+int pb_rope_iov(pbRope *r, long off, struct iovec *iov, int max) {
+	pbRopeSeg *s;
+	int i, cnt = 0;
+	long skip;
+
+	if( 0 > off || r->len <= off )
+		return 0;
+	for( i = _pb_rope_find(r,off); r->cnt > i && max > cnt; ++i, ++cnt ) {
+		s = &r->segs[i];
+		skip = off > s->off ? off - s->off : 0;
+		iov[cnt].iov_base = pb_data(s->buf) + skip;
+		iov[cnt].iov_len = pb_len(s->buf) - skip;
+	}
+	return cnt;
+}
+
+int pb_rope_write_fd(pbRope *r, int fd, long *off) {
+	struct iovec iov[PB_CHAIN_MAX];
+	int n, cnt;
+
+	cnt = pb_rope_iov(r,*off,iov,PB_CHAIN_MAX);
+	if( 0 == cnt )
+		return 0;
+	n = writev(fd,iov,cnt);
+	if( 0 < n )
+		*off += n;
+	return n;
+}
+
+char *pb_rope_flatten(pbRope *r) {
+	char *p;
+	int i;
+
+	if( PB_SIZE_MAX < r->len )
+		return NULL;
+	if( !(p = pb_new(r->len)) )
+		return NULL;
+	for( i = 0; r->cnt > i; ++i ) {
+		memcpy(pb_tail(p),pb_data(r->segs[i].buf),pb_len(r->segs[i].buf));
+		pb_incr_len(p,pb_len(r->segs[i].buf));
+	}
+	return p;
+}
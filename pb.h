@@ -6,26 +6,141 @@
 #ifndef __PB_H_
 #define __PB_H_
 
+#include <sys/uio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* -------------------------------- define ----------------------------------- */
+
+#define PB_OK 1
+#define PB_ERR 0
+
+#define PB_CHAIN_MAX 64
+
+/* -------------------------------- struct ----------------------------------- */
+
+typedef struct pbSlice {
+	const char *ptr;
+	int len;
+} pbSlice;
+
+typedef struct pbSplit {
+	const char *ptr;
+	const char *end;
+	const char *set;
+} pbSplit;
+
+/* A chain borrows its buffers. Reading may detach a shared buffer, in
+ * which case the chain slot is updated to the private copy. Writing leaves
+ * the buffers alone and tracks progress in the caller's offset. */
+typedef struct pbChain {
+	int cnt;
+	char *bufs[PB_CHAIN_MAX];
+} pbChain;
+
+/* Fixed capacity ring over a mirrored mapping: the readable and the
+ * writable regions are always contiguous, nothing is ever moved. head and
+ * tail run freely and are masked on access. */
+typedef struct pbRing {
+	char *buf;
+	unsigned int size;
+	unsigned int head;
+	unsigned int tail;
+	int fd;
+} pbRing;
+
+/* Segmented buffer for large payloads. Each segment is a pb held by
+ * reference with the offset of its first byte, so lookups by offset are
+ * a binary search and appends never move earlier data. Joining ropes
+ * links segments instead of copying them (see bench/pb_rope.c). */
+typedef struct pbRopeSeg {
+	char *buf;
+	long off;
+} pbRopeSeg;
+
+typedef struct pbRope {
+	pbRopeSeg *segs;
+	int cnt;
+	int cap;
+	long len;
+} pbRope;
+
 /* -------------------------------- api functions ---------------------------- */
 
 char *pb_new(int size);
 char *pb_new_len(char *p, int size);
 char *pb_renew(char *p, int size);
 void pb_free(char *p);
+char *pb_ref(char *p);
+void pb_unref(char *p);
+int pb_shared(char *p);
 int pb_size(char *p);
 int pb_len(char *p);
-void pb_set_len(char *p, int len);
+char *pb_set_len(char *p, int len);
+/* pb_incr_len and writes through pb_tail do not detach a shared buffer;
+ * make room with pb_renew first, which does. */
 void pb_incr_len(char *p, int len);
+char *pb_data(char *p);
+char *pb_tail(char *p);
 char *pb_cat(char *p, const char *buf, int len);
 int pb_cmp(char *p, const char *buf, int len);
+int pb_casecmp(char *p, const char *buf, int len);
+int pb_find_byte(char *p, int from, char c);
+int pb_find_any(char *p, int from, const char *set);
+int pb_find(char *p, int from, const char *buf, int len);
+void pb_split_init(pbSplit *it, char *p, const char *set);
+int pb_split_next(pbSplit *it, pbSlice *s);
 char *pb_cpy(char *p, const char *buf, int len);
 char *pb_sub(char *p, int begin, int end);
-void pb_mov(char *p, int begin, int end);
+pbSlice pb_slice(char *p, int begin, int end);
+char *pb_slice_dup(pbSlice s);
+/* pb_mov keeps p pointing at the string, so it moves the bytes it keeps.
+ * pb_consume drops len bytes from the front by advancing a head offset
+ * instead. WARNING: after pb_consume p is still the handle but no longer
+ * the start of the string; read it through pb_data(), never through p. */
+char *pb_mov(char *p, int begin, int end);
+char *pb_consume(char *p, int len);
 char *pb_sprintf(char *p, const char *fmt, ...);
+char *pb_cat_char(char *p, char c);
+char *pb_cat_long(char *p, long value);
+char *pb_cat_ulong(char *p, unsigned long value);
+char *pb_cat_double(char *p, double value);
+
+int pb_read_fd(char **p, int fd, int max);
+/* The write calls send the bytes from *off on and advance it. The buffers
+ * themselves are left alone, so one shared buffer can go out to many fds
+ * without copies; pb_consume the written bytes from an owned one. */
+int pb_write_fd(char *p, int fd, int *off);
+int pb_slice_write_fd(pbSlice *s, int fd);
+
+void pb_chain_init(pbChain *c);
+int pb_chain_add(pbChain *c, char *p);
+int pb_chain_read_fd(pbChain *c, int fd);
+int pb_chain_write_fd(pbChain *c, int fd, long *off);
+
+pbRing *pb_ring_create(int size);
+void pb_ring_destroy(pbRing *r);
+int pb_ring_len(pbRing *r);
+int pb_ring_free(pbRing *r);
+char *pb_ring_reserve(pbRing *r, int *len);
+int pb_ring_commit(pbRing *r, int len);
+char *pb_ring_peek(pbRing *r, int *len);
+int pb_ring_consume(pbRing *r, int len);
+int pb_ring_read_fd(pbRing *r, int fd);
+int pb_ring_write_fd(pbRing *r, int fd);
+
+void pb_rope_init(pbRope *r);
+void pb_rope_free(pbRope *r);
+long pb_rope_len(pbRope *r);
+int pb_rope_cat(pbRope *r, const char *buf, int len);
+int pb_rope_add(pbRope *r, char *p);
+int pb_rope_join(pbRope *r, pbRope *other);
+int pb_rope_at(pbRope *r, long off);
+int pb_rope_iov(pbRope *r, long off, struct iovec *iov, int max);
+int pb_rope_write_fd(pbRope *r, int fd, long *off);
+char *pb_rope_flatten(pbRope *r);
 
 #ifdef __cplusplus
 }
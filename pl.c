@@ -3,6 +3,11 @@
  * This library is free software; you can redistribute it and/or modify
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,15 +15,32 @@
 
 #include "pl.h"
 
+/* -------------------------------- struct ----------------------------------- */
+
+struct plReplace {
+	int states;
+	int classes;
+	unsigned char cls[256];
+	int *next;
+	int *out;
+	const char **rep;
+	int *orglen;
+	int *replen;
+};
+
 /* -------------------------------- define ----------------------------------- */
 
-#define PL_ARG_SIZE sizeof(unsigned int) * 4
-#define PL_END_SIZE sizeof(unsigned int)
 #define PL_OFF_SIZE sizeof(unsigned int)
 
 #define PL_FREE(_p) \
 	do { if(_p) { free(_p); _p = NULL; } } while(0)
 
+/* first position at or after _m where the size header can go so that the
+ * memory behind it is PL_ALIGN_SIZE aligned; large allocations put the
+ * header in the last PL_OFF_SIZE bytes of a PL_ALIGN_SIZE prefix instead */
+#define PL_ALIGN(_m) \
+	((void *)((((unsigned long)(_m) + PL_OFF_SIZE + PL_ALIGN_SIZE - 1) & ~(PL_ALIGN_SIZE - 1UL)) - PL_OFF_SIZE))
+
 /* -------------------------------- private ---------------------------------- */
 
 static void _pl_init(plHandle *pl);
@@ -26,6 +48,9 @@ static void _pl_init(plHandle *pl);
 static void *_pl_alloc_block(plHandle *pl, int size);
 static void *_pl_alloc_large(plHandle *pl, int size);
 
+static int _pl_replace_count(const char *src, int srclen, const char *org, int orglen);
+static long _pl_replace_scan(plReplace *rp, const char *src, int srclen, char *buf);
+
 /* -------------------------------- private implementation ------------------- */
 
 static void _pl_init(plHandle *pl) {
@@ -55,7 +80,7 @@ static void *_pl_alloc_block(plHandle *pl, int size) {
 	n->data.next = NULL;
 	n->data.failed = 0;
 
-	m = (void *)(n) + sizeof(*pl);
+	m = PL_ALIGN((void *)(n) + sizeof(*pl));
 	((unsigned int *)m)[0] = size;
 	m += PL_OFF_SIZE;
 	n->data.last = m + size;
@@ -72,11 +97,11 @@ static void *_pl_alloc_large(plHandle *pl, int size) {
 	plLarge *l;
 	void *p;
 
-	p = malloc(PL_OFF_SIZE + size);
+	p = malloc(PL_ALIGN_SIZE + size);
 	if( !p )
 		return NULL;
 
-	((unsigned int *)p)[0] = size;
+	((unsigned int *)(p + PL_ALIGN_SIZE - PL_OFF_SIZE))[0] = size;
 
 	l = pl->free;
 	if( l ) {
@@ -93,7 +118,7 @@ static void *_pl_alloc_large(plHandle *pl, int size) {
 		if( pl->large )
 			pl->large->prev = l;
 		pl->large = l;
-		return p + PL_OFF_SIZE;
+		return p + PL_ALIGN_SIZE;
 	}
 
 	l = pl_alloc(pl,sizeof(*l));
@@ -107,7 +132,44 @@ static void *_pl_alloc_large(plHandle *pl, int size) {
 	if( pl->large )
 		pl->large->prev = l;
 	pl->large = l;
-	return p + PL_OFF_SIZE;
+	return p + PL_ALIGN_SIZE;
+}
+
+static int _pl_replace_count(const char *src, int srclen, const char *org, int orglen) {
+	const char *top = src, *end = src + srclen;
+	int n = 0;
+
+	while( (top = memmem(top,end - top,org,orglen)) ) {
+		top += orglen;
+		n++;
+	}
+	return n;
+}
+
+/* Runs the automaton over src. With buf == NULL only the output length
+ * is computed, otherwise the output is written to buf. A match is taken
+ * at the first position where any pattern ends, preferring the longest
+ * pattern ending there, and scanning restarts right after it. */
+static long _pl_replace_scan(plReplace *rp, const char *src, int srclen, char *buf) {
+	const unsigned char *s = (const unsigned char *)src;
+	long len = 0;
+	int i, k, state = 0, last = 0;
+
+	for( i = 0; srclen > i; ++i ) {
+		state = rp->next[state * rp->classes + rp->cls[s[i]]];
+		if( 0 > (k = rp->out[state]) )
+			continue;
+		if( buf ) {
+			memcpy(buf + len,src + last,i + 1 - rp->orglen[k] - last);
+			memcpy(buf + len + i + 1 - rp->orglen[k] - last,rp->rep[k],rp->replen[k]);
+		}
+		len += i + 1 - rp->orglen[k] - last + rp->replen[k];
+		last = i + 1;
+		state = 0;
+	}
+	if( buf )
+		memcpy(buf + len,src + last,srclen - last);
+	return len + srclen - last;
 }
 
 /* -------------------------------- api implementation ----------------------- */
@@ -154,11 +216,11 @@ void *pl_alloc(plHandle *pl, int size) {
 	plHandle *p = NULL;
 	void *m = NULL;
 
-	if( pl->max >= (unsigned int)PL_OFF_SIZE + size ) {
+	if( pl->max >= (unsigned int)PL_ALIGN_SIZE + size ) {
 		p = pl->current;
 		do {
-			m = p->data.last;
-			if( p->data.end - m >= (unsigned int)PL_OFF_SIZE + size ) {
+			m = PL_ALIGN(p->data.last);
+			if( p->data.end - m >= (long)PL_OFF_SIZE + size ) {
 				((unsigned int *)m)[0] = size;
 				m += PL_OFF_SIZE;
 				p->data.last = m + size;
@@ -198,9 +260,10 @@ void pl_free(plHandle *pl, void *p) {
 	plLarge *l;
 	void *ptr = p - PL_OFF_SIZE;
 
-	if( pl->max >= ((unsigned int *)ptr)[0] )
+	if( pl->max >= (unsigned int)PL_ALIGN_SIZE + ((unsigned int *)ptr)[0] )
 		return;
 
+	ptr = p - PL_ALIGN_SIZE;
 	for( l = pl->large; l; l = l->next ) {
 		if( l->alloc == ptr ) {
 			if( l->prev )
@@ -230,72 +293,205 @@ char *pl_strdup(plHandle *pl, const char *src, int len) {
 	return buf;
 }
 
-char *pl_sprintf(plHandle *pl, const char *fmt, ...) {
-	char *buf = (char *)fmt;
-	char *arg;
-	int len = strlen(fmt) + PL_END_SIZE;
-
-	va_list ap;
-	va_start(ap,fmt);
+char *pl_vsprintf(plHandle *pl, const char *fmt, va_list ap) {
+	plHandle *p = pl->current;
+	void *m = NULL;
+	char *buf;
+	int len, size = 0;
+	va_list cp;
+
+	/* format straight into the tail of the current block, on overflow
+	 * vsnprintf already told us the exact length for the second pass */
+	if( p ) {
+		m = PL_ALIGN(p->data.last);
+		size = (int)(p->data.end - m) - (int)PL_OFF_SIZE;
+	}
 
-	while( (buf = strchr(buf,'%')) ) {
-		arg = va_arg(ap,char *);
-		switch( buf[1] ) {
-		case 's':
-			len += strlen(arg);
-			len += PL_END_SIZE;
-			break;
-		default:
-			len += PL_ARG_SIZE;
-			break;
+	va_copy(cp,ap);
+	if( 0 < size ) {
+		buf = m + PL_OFF_SIZE;
+		len = vsnprintf(buf,size,fmt,cp);
+		va_end(cp);
+		if( 0 > len )
+			return NULL;
+		if( size > len ) {
+			((unsigned int *)m)[0] = len + 1;
+			p->data.last = buf + len + 1;
+			return buf;
 		}
-		buf++;
+	} else {
+		len = vsnprintf(NULL,0,fmt,cp);
+		va_end(cp);
+		if( 0 > len )
+			return NULL;
 	}
 
-	buf = pl_alloc(pl,len);
+	buf = pl_alloc(pl,len + 1);
 	if( !buf )
 		return NULL;
-	buf[0] = '\0';
+	vsnprintf(buf,len + 1,fmt,ap);
+	return buf;
+}
 
+char *pl_sprintf(plHandle *pl, const char *fmt, ...) {
+	char *buf;
+	va_list ap;
 	va_start(ap,fmt);
-	vsnprintf(buf,len-1,fmt,ap);
+	buf = pl_vsprintf(pl,fmt,ap);
 	va_end(ap);
 	return buf;
 }
 
 char *pl_replace(plHandle *pl, const char *src, const char *org, const char *rep) {
-	char *top = (char *)src, *end;
+	return pl_replace_len(pl,src,strlen(src),org,strlen(org),rep,strlen(rep),NULL);
+}
+
+char *pl_replace_len(plHandle *pl, const char *src, int srclen, const char *org, int orglen, const char *rep, int replen, int *outlen) {
+	const char *top = src, *end = src + srclen, *hit;
 	char *buf, *ptr;
-	int srclen = strlen(src);
-	int orglen = strlen(org);
-	int replen = strlen(rep);
-	int len = srclen + 1;
+	long len = srclen;
+	int n;
 
-	if( !srclen || !orglen )
+	if( 0 >= srclen || 0 >= orglen )
 		return NULL;
 
-	if( orglen < replen )
-		len = replen * (srclen / orglen + 1);
+	if( orglen != replen ) {
+		n = _pl_replace_count(src,srclen,org,orglen);
+		len += (long)n * (replen - orglen);
+		if( INT_MAX <= len )
+			return NULL;
+	}
 
-	buf = pl_calloc(pl,len);
+	buf = pl_alloc(pl,len + 1);
 	if( !buf )
 		return NULL;
 
 	ptr = buf;
-	while( '\0' != top[0] ) {
-		end = strstr(top,org);
-		if( !end )
-			break;
-		len = end - top;
-		if( 0 < len ) {
-			memcpy(ptr,top,len);
-			ptr += len;
-			top += len;
-		}
+	while( (hit = memmem(top,end - top,org,orglen)) ) {
+		memcpy(ptr,top,hit - top);
+		ptr += hit - top;
 		memcpy(ptr,rep,replen);
 		ptr += replen;
-		top += orglen;
+		top = hit + orglen;
 	}
-	memcpy(ptr,top,strlen(top));
+	memcpy(ptr,top,end - top);
+	buf[len] = '\0';
+	if( outlen )
+		outlen[0] = len;
+	return buf;
+}
+
+plReplace *pl_replace_compile(plHandle *pl, const char **org, const int *orglen, const char **rep, const int *replen, int n) {
+	plReplace *rp;
+	int *fail, *queue;
+	int i, j, c, s, t, head, tail;
+	long states = 1, size = 0;
+	char *text;
+
+	rp = pl_calloc(pl,sizeof(*rp));
+	if( !rp )
+		return NULL;
+
+	/* bytes that occur in no pattern share class 0 and always lead back
+	 * to the root, which keeps the transition table narrow */
+	rp->classes = 1;
+	for( i = 0; n > i; ++i ) {
+		for( j = 0; orglen[i] > j; ++j ) {
+			c = ((const unsigned char *)org[i])[j];
+			if( !rp->cls[c] )
+				rp->cls[c] = rp->classes++;
+		}
+		states += 0 < orglen[i] ? orglen[i] : 0;
+		size += 0 < replen[i] ? replen[i] : 0;
+	}
+	if( (long)(INT_MAX / sizeof(int)) / rp->classes <= states || INT_MAX <= size )
+		return NULL;
+
+	rp->next = pl_alloc(pl,states * rp->classes * sizeof(int));
+	rp->out = pl_alloc(pl,states * sizeof(int));
+	rp->rep = pl_alloc(pl,(n + 1) * sizeof(char *));
+	rp->orglen = pl_alloc(pl,(n + 1) * sizeof(int));
+	rp->replen = pl_alloc(pl,(n + 1) * sizeof(int));
+	text = pl_alloc(pl,size + 1);
+	fail = pl_alloc(pl,states * sizeof(int));
+	queue = pl_alloc(pl,states * sizeof(int));
+	if( !rp->next || !rp->out || !rp->rep || !rp->orglen || !rp->replen || !text || !fail || !queue )
+		return NULL;
+	memset(rp->next,0xff,states * rp->classes * sizeof(int));
+	memset(rp->out,0xff,states * sizeof(int));
+
+	/* trie, the first of duplicate patterns wins; the replacements are
+	 * copied next to the tables so the caller's strings may go away */
+	rp->states = 1;
+	for( i = 0; n > i; ++i ) {
+		rp->rep[i] = text;
+		if( 0 < replen[i] ) {
+			memcpy(text,rep[i],replen[i]);
+			text += replen[i];
+		}
+		rp->orglen[i] = orglen[i];
+		rp->replen[i] = replen[i];
+		if( 0 >= orglen[i] )
+			continue;
+		for( s = 0, j = 0; orglen[i] > j; ++j ) {
+			c = rp->cls[((const unsigned char *)org[i])[j]];
+			if( 0 > rp->next[s * rp->classes + c] )
+				rp->next[s * rp->classes + c] = rp->states++;
+			s = rp->next[s * rp->classes + c];
+		}
+		if( 0 > rp->out[s] )
+			rp->out[s] = i;
+	}
+
+	/* breadth first pass turning the trie into a full automaton, each
+	 * state reports the longest pattern that is a suffix of it */
+	head = tail = 0;
+	for( c = 0; rp->classes > c; ++c ) {
+		t = rp->next[c];
+		if( 0 > t ) {
+			rp->next[c] = 0;
+			continue;
+		}
+		fail[t] = 0;
+		queue[tail++] = t;
+	}
+	while( head < tail ) {
+		s = queue[head++];
+		if( 0 > rp->out[s] )
+			rp->out[s] = rp->out[fail[s]];
+		for( c = 0; rp->classes > c; ++c ) {
+			t = rp->next[s * rp->classes + c];
+			if( 0 > t ) {
+				rp->next[s * rp->classes + c] = rp->next[fail[s] * rp->classes + c];
+				continue;
+			}
+			fail[t] = rp->next[fail[s] * rp->classes + c];
+			queue[tail++] = t;
+		}
+	}
+
+	pl_free(pl,fail);
+	pl_free(pl,queue);
+	return rp;
+}
+
+char *pl_replace_exec(plHandle *pl, plReplace *rp, const char *src, int srclen, int *outlen) {
+	char *buf;
+	long len;
+
+	if( 0 > srclen )
+		return NULL;
+
+	len = _pl_replace_scan(rp,src,srclen,NULL);
+	if( INT_MAX <= len )
+		return NULL;
+
+	buf = pl_alloc(pl,len + 1);
+	if( !buf )
+		return NULL;
+	_pl_replace_scan(rp,src,srclen,buf);
+	buf[len] = '\0';
+	if( outlen )
+		outlen[0] = len;
 	return buf;
 }
@@ -6,6 +6,8 @@
 #ifndef __PL_H_
 #define __PL_H_
 
+#include <stdarg.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,6 +21,7 @@ typedef struct plLarge {
 } plLarge;
 
 typedef struct plHandle plHandle;
+typedef struct plReplace plReplace;
 
 typedef struct plData {
 	void *last;
@@ -42,6 +45,9 @@ typedef struct plHandle {
 
 #define PL_PAGE_SIZE (1024 * 4)
 
+/* every pointer from pl_alloc and friends is aligned to this */
+#define PL_ALIGN_SIZE 8
+
 /* -------------------------------- api functions ---------------------------- */
 
 plHandle *pl_create(void);
@@ -55,7 +61,13 @@ void pl_free(plHandle *pl, void *p);
 
 char *pl_strdup(plHandle *pl, const char *src, int len);
 char *pl_sprintf(plHandle *pl, const char *fmt, ...);
+char *pl_vsprintf(plHandle *pl, const char *fmt, va_list ap);
 char *pl_replace(plHandle *pl, const char *src, const char *org, const char *rep);
+char *pl_replace_len(plHandle *pl, const char *src, int srclen, const char *org, int orglen, const char *rep, int replen, int *outlen);
+/* the compiled dictionary copies what it needs from org and rep and lives
+ * in pl until pl_reset or pl_destroy */
+plReplace *pl_replace_compile(plHandle *pl, const char **org, const int *orglen, const char **rep, const int *replen, int n);
+char *pl_replace_exec(plHandle *pl, plReplace *rp, const char *src, int srclen, int *outlen);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,146 @@
+/* Memory Pool Library C++ Adapters.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ */
+
+#ifndef __PL_HPP_
+#define __PL_HPP_
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "pl.h"
+
+namespace ctl {
+
+/* -------------------------------- private ---------------------------------- */
+
+/* pl_alloc aligns to PL_ALIGN_SIZE, which covers most requests as they
+ * are. Stricter ones are padded by align - 1 bytes, and when they may be
+ * served as large allocations they also keep the raw pointer just below
+ * the aligned one so that they can be handed back with pl_free; pl_free
+ * ignores pointers from the blocks. */
+
+inline bool _pl_is_large(plHandle *pl, std::size_t size) noexcept {
+	return size + sizeof(void *) >= pl->max;
+}
+
+inline void *_pl_aligned_alloc(plHandle *pl, std::size_t bytes, std::size_t align) {
+	std::size_t size = bytes;
+	std::uintptr_t p;
+	bool large;
+	void *raw;
+
+	if( PL_ALIGN_SIZE >= align ) {
+		if( INT_MAX < size || !(raw = pl_alloc(pl,(int)size)) )
+			throw std::bad_alloc();
+		return raw;
+	}
+
+	size += align - 1;
+	if( size < bytes )
+		throw std::bad_alloc();
+	large = _pl_is_large(pl,size);
+	if( large )
+		size += sizeof(void *);
+	if( INT_MAX < size )
+		throw std::bad_alloc();
+
+	raw = pl_alloc(pl,(int)size);
+	if( !raw )
+		throw std::bad_alloc();
+
+	p = reinterpret_cast<std::uintptr_t>(raw);
+	if( large )
+		p += sizeof(void *);
+	p = (p + align - 1) & ~(std::uintptr_t)(align - 1);
+	if( large )
+		reinterpret_cast<void **>(p)[-1] = raw;
+	return reinterpret_cast<void *>(p);
+}
+
+inline void _pl_aligned_free(plHandle *pl, void *p, std::size_t bytes, std::size_t align) noexcept {
+	if( p && PL_ALIGN_SIZE >= align )
+		pl_free(pl,p);
+	else if( p && _pl_is_large(pl,bytes + align - 1) )
+		pl_free(pl,reinterpret_cast<void **>(p)[-1]);
+}
+
+/* -------------------------------- memory resource -------------------------- */
+
+/* std::pmr::memory_resource backed by a plHandle. Blocks are released
+ * together by pl_reset/pl_destroy, only large allocations are returned
+ * early. The resource does not own the pool. */
+class plResource : public std::pmr::memory_resource {
+public:
+	explicit plResource(plHandle *pl) noexcept : pl_(pl) {}
+
+	plHandle *handle() const noexcept { return pl_; }
+
+private:
+	void *do_allocate(std::size_t bytes, std::size_t align) override {
+		return _pl_aligned_alloc(pl_,bytes,align);
+	}
+
+	void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+		_pl_aligned_free(pl_,p,bytes,align);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		const plResource *res = dynamic_cast<const plResource *>(&other);
+		return res && res->pl_ == pl_;
+	}
+
+	plHandle *pl_;
+};
+
+/* -------------------------------- allocator -------------------------------- */
+
+/* Stateful STL allocator drawing from a plHandle. Copies share the pool
+ * and follow the container on copy, move and swap. */
+template <typename T>
+class plAllocator {
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	explicit plAllocator(plHandle *pl) noexcept : pl_(pl) {}
+
+	template <typename U>
+	plAllocator(const plAllocator<U> &other) noexcept : pl_(other.handle()) {}
+
+	T *allocate(std::size_t n) {
+		if( (std::size_t)INT_MAX / sizeof(T) < n )
+			throw std::bad_array_new_length();
+		return static_cast<T *>(_pl_aligned_alloc(pl_,n * sizeof(T),alignof(T)));
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept {
+		_pl_aligned_free(pl_,p,n * sizeof(T),alignof(T));
+	}
+
+	plHandle *handle() const noexcept { return pl_; }
+
+private:
+	plHandle *pl_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const plAllocator<T> &a, const plAllocator<U> &b) noexcept {
+	return a.handle() == b.handle();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const plAllocator<T> &a, const plAllocator<U> &b) noexcept {
+	return a.handle() != b.handle();
+}
+
+} /* namespace ctl */
+
+#endif /* __PL_HPP_ */
@@ -0,0 +1,157 @@
+/* String Buffer Implementation.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sb.h"
+
+/* -------------------------------- define ----------------------------------- */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SB_HEAP_FLAG ((size_t)0x80)
+#define SB_HEAP_MASK (~(size_t)0xff)
+#else
+#define SB_HEAP_FLAG ((size_t)1 << (sizeof(size_t) * 8 - 1))
+#define SB_HEAP_MASK (~SB_HEAP_FLAG)
+#endif
+
+#define SB_FREE(_p) \
+	do { if(_p) { free(_p); _p = NULL; } } while(0)
+
+#define SB_MAX(_a,_b) \
+	(_a) > (_b) ? (_a) : (_b)
+
+#define SB_TAG(_s) ((_s)->u.buf[SB_INLINE_MAX])
+#define SB_IS_HEAP(_s) (0x80 & (unsigned char)SB_TAG(_s))
+
+/* -------------------------------- private ---------------------------------- */
+
+static size_t _sb_grow_size(size_t cap, size_t need);
+static int _sb_grow(sbString *s, size_t need);
+
+/* -------------------------------- private implementation ------------------- */
+
+static size_t _sb_grow_size(size_t cap, size_t need) {
+	size_t size;
+	if( SB_GROW_LIMIT > need ) {
+		size = SB_MAX(cap * 2,need + 8);
+	} else {
+		size = need + SB_GROW_CHUNK;
+		if( size < need )
+			size = need;
+	}
+	/* on big-endian hosts the low byte of cap holds the flag */
+	if( SB_HEAP_MASK != ~SB_HEAP_FLAG )
+		size = (size + 0xff) & SB_HEAP_MASK;
+	return size;
+}
+
+static int _sb_grow(sbString *s, size_t need) {
+	size_t len = sb_len(s);
+	size_t cap = _sb_grow_size(sb_size(s),need);
+	char *ptr;
+
+	if( cap < need || (SB_HEAP_MASK & cap) != cap )
+		return SB_ERR;
+
+	if( SB_IS_HEAP(s) ) {
+		ptr = realloc(s->u.heap.ptr,cap + 1);
+		if( !ptr )
+			return SB_ERR;
+	} else {
+		ptr = malloc(cap + 1);
+		if( !ptr )
+			return SB_ERR;
+		memcpy(ptr,s->u.buf,len + 1);
+	}
+	s->u.heap.ptr = ptr;
+	s->u.heap.len = len;
+	s->u.heap.cap = cap | SB_HEAP_FLAG;
+	return SB_OK;
+}
+
+/* -------------------------------- api implementation ----------------------- */
+
+void sb_init(sbString *s) {
+	s->u.buf[0] = '\0';
+	SB_TAG(s) = SB_INLINE_MAX;
+}
+
+int sb_init_len(sbString *s, const char *buf, size_t len) {
+	sb_init(s);
+	return sb_cpy(s,buf,len);
+}
+
+void sb_free(sbString *s) {
+	if( SB_IS_HEAP(s) )
+		SB_FREE(s->u.heap.ptr);
+	sb_init(s);
+}
+
+char *sb_data(sbString *s) {
+	return SB_IS_HEAP(s) ? s->u.heap.ptr : s->u.buf;
+}
+
+size_t sb_len(const sbString *s) {
+	if( SB_IS_HEAP(s) )
+		return s->u.heap.len;
+	return SB_INLINE_MAX - (unsigned char)SB_TAG(s);
+}
+
+size_t sb_size(const sbString *s) {
+	if( SB_IS_HEAP(s) )
+		return s->u.heap.cap & SB_HEAP_MASK;
+	return SB_INLINE_MAX;
+}
+
+int sb_reserve(sbString *s, size_t size) {
+	size_t len = sb_len(s);
+	if( len + size < len )
+		return SB_ERR;
+	if( sb_size(s) - len >= size )
+		return SB_OK;
+	return _sb_grow(s,len + size);
+}
+
+int sb_set_len(sbString *s, size_t len) {
+	if( sb_size(s) < len )
+		return SB_ERR;
+	if( SB_IS_HEAP(s) ) {
+		s->u.heap.len = len;
+		s->u.heap.ptr[len] = '\0';
+	} else {
+		s->u.buf[len] = '\0';
+		SB_TAG(s) = SB_INLINE_MAX - len;
+	}
+	return SB_OK;
+}
+
+int sb_cat(sbString *s, const char *buf, size_t len) {
+	size_t old = sb_len(s);
+	if( 0 == len )
+		return SB_OK;
+	if( !sb_reserve(s,len) )
+		return SB_ERR;
+	memcpy(sb_data(s) + old,buf,len);
+	sb_set_len(s,old + len);
+	return SB_OK;
+}
+
+int sb_cpy(sbString *s, const char *buf, size_t len) {
+	if( sb_size(s) < len && !_sb_grow(s,len) )
+		return SB_ERR;
+	memmove(sb_data(s),buf,len);
+	sb_set_len(s,len);
+	return SB_OK;
+}
+
+int sb_cmp(sbString *s, const char *buf, size_t len) {
+	size_t slen = sb_len(s);
+	int r = memcmp(sb_data(s),buf,slen < len ? slen : len);
+	if( r || slen == len )
+		return r;
+	return slen < len ? -1 : 1;
+}
@@ -0,0 +1,68 @@
+/* String Buffer Implementation.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ */
+
+#ifndef __SB_H_
+#define __SB_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -------------------------------- struct ----------------------------------- */
+
+/* sb or pb: a pb is a heap handle passed around by pointer. It brings
+ * reference counting, a head offset, fd I/O and the search helpers, and
+ * holds at most INT_MAX bytes. An sbString is a plain value, kept inside
+ * another struct or on the stack, that needs no allocation up to
+ * SB_INLINE_MAX bytes and has size_t lengths. Use sb for the many short
+ * keys and tokens stored in records, and for strings that may outgrow
+ * 2 GB; use pb for I/O buffers and for anything that is shared. */
+
+/* Strings up to SB_INLINE_MAX bytes live inside the struct. The last byte
+ * then holds the remaining inline room, so a full inline string is still
+ * terminated by it. Longer strings move to the heap and the same byte,
+ * which overlaps the top of cap, carries SB_HEAP_FLAG. */
+typedef struct sbString {
+	union {
+		struct {
+			char *ptr;
+			size_t len;
+			size_t cap;
+		} heap;
+		char buf[3 * sizeof(size_t)];
+	} u;
+} sbString;
+
+/* -------------------------------- define ----------------------------------- */
+
+#define SB_OK 1
+#define SB_ERR 0
+
+#define SB_INLINE_MAX (sizeof(sbString) - 1)
+
+#define SB_GROW_LIMIT (1024 * 1024)
+#define SB_GROW_CHUNK (1024 * 1024)
+
+/* -------------------------------- api functions ---------------------------- */
+
+void sb_init(sbString *s);
+int sb_init_len(sbString *s, const char *buf, size_t len);
+void sb_free(sbString *s);
+char *sb_data(sbString *s);
+size_t sb_len(const sbString *s);
+size_t sb_size(const sbString *s);
+int sb_reserve(sbString *s, size_t size);
+int sb_set_len(sbString *s, size_t len);
+int sb_cat(sbString *s, const char *buf, size_t len);
+int sb_cpy(sbString *s, const char *buf, size_t len);
+int sb_cmp(sbString *s, const char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SB_H_ */